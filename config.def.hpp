@@ -9,6 +9,9 @@ const unsigned int gappx     = 5;        /* gaps between windows */
 const unsigned int snap      = 32;       /* snap pixel */
 const int showbar            = 1;        /* 0 means no bar */
 const int topbar             = 1;        /* 0 means bottom bar */
+const unsigned int barfps    = 60;       /* most bar redraws per second */
+const unsigned int hotplugdelay = 250;   /* ms for the outputs to settle */
+const unsigned int focusdelay = 0;       /* ms between pointer focus changes */
 const std::vector<std::string> fonts { "monospace:size=10" };
 const char dmenufont[]       = "monospace:size=10";
 const char col_gray1[]       = "#222222";
@@ -28,6 +31,21 @@ const Theme<ColorScheme> colors {
 		.background = col_cyan,
 		.border = col_cyan,
 	},
+	.urgent = {
+		.foreground = col_gray1,
+		.background = col_gray3,
+		.border = col_gray2,
+	},
+	/* optional colors of a selected tag, by tag index */
+	.tags = {},
+};
+
+/* status blocks, drawn right of the root window name. Send "@name text"
+ * to the status socket to update one of them. */
+const std::vector<StatusBlockRule> statusblocks {
+	/* name       colors */
+	/* { "cpu",      {} }, */
+	/* { "date",     ColorScheme{ col_gray4, col_cyan, col_cyan } }, */
 };
 
 /* tagging */
@@ -116,15 +134,15 @@ Key keys[] = {
 
 /* button definitions */
 /* click can be ClkTagBar, ClkLtSymbol, ClkStatusText, ClkWinTitle, ClkClientWin, or ClkRootWin */
-const std::array<Button, 11> buttons = {{
+constexpr std::array<Button, 11> buttons = {{
 	/* click                event mask      button          function */
-	{ ClkLtSymbol,          0,              Button1,        [](int){togglelayout();}},
-	{ ClkLtSymbol,          0,              Button3,        [](int){setlayout(&layouts[2]);}},
-	{ ClkWinTitle,          0,              Button2,        [](int){zoom();}},
-	{ ClkStatusText,        0,              Button2,        [](int){spawn(terminal);}},
-	{ ClkClientWin,         MODKEY,         Button1,        [](int){movemouse();}},
-	{ ClkClientWin,         MODKEY,         Button2,        [](int){togglefloating();}},
-	{ ClkClientWin,         MODKEY,         Button3,        [](int){resizemouse();}},
+	{ ClkLtSymbol,          0,              Button1,        [](uint){togglelayout();}},
+	{ ClkLtSymbol,          0,              Button3,        [](uint){setlayout(&layouts[2]);}},
+	{ ClkWinTitle,          0,              Button2,        [](uint){zoom();}},
+	{ ClkStatusText,        0,              Button2,        [](uint){spawn(terminal);}},
+	{ ClkClientWin,         MODKEY,         Button1,        [](uint){movemouse();}},
+	{ ClkClientWin,         MODKEY,         Button2,        [](uint){togglefloating();}},
+	{ ClkClientWin,         MODKEY,         Button3,        [](uint){resizemouse();}},
 	{ ClkTagBar,            0,              Button1,        view },
 	{ ClkTagBar,            0,              Button3,        toggleview },
 	{ ClkTagBar,            MODKEY,         Button1,        tag },
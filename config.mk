@@ -14,16 +14,32 @@ X11LIB = /usr/X11R6/lib
 XINERAMALIBS  = -lXinerama
 XINERAMAFLAGS = -DXINERAMA
 
+# XRandR 1.5 monitors, preferred over Xinerama when the server has them
+XRANDRLIBS  = -lXrandr
+XRANDRFLAGS = -DXRANDR
+
+# XInput 2 pointer tracking, comment to use core crossing and motion events
+XINPUT2LIBS  = -lXi
+XINPUT2FLAGS = -DXINPUT2
+
+# XCB, pipelines the queries that adopt open windows at startup
+XCBLIBS  = -lX11-xcb -lxcb
+XCBFLAGS = -DXCB
+
 # freetype
-FREETYPELIBS = -lfontconfig -lXft
+FREETYPELIBS = -lfontconfig -lXft -lXrender -lfreetype
 FREETYPEINC = /usr/include/freetype2
 
+# MIT-SHM client-side bar rendering, uncomment if you want it
+#SHMBARLIBS  = -lXext
+#SHMBARFLAGS = -DSHMBAR
+
 # includes and libs
 INCS = -I${X11INC} -I${FREETYPEINC}
-LIBS = -lstdc++ -L${X11LIB} -lX11 ${XINERAMALIBS} ${FREETYPELIBS}
+LIBS = -lstdc++ -L${X11LIB} -lX11 ${XINERAMALIBS} ${XRANDRLIBS} ${XINPUT2LIBS} ${XCBLIBS} ${FREETYPELIBS} ${SHMBARLIBS}
 
 # flags
-CXXFLAGS = -std=c++20 -Wpedantic -Wall -Wextra -Wno-deprecated-declarations ${INCS} -D_DEFAULT_SOURCE -DVERSION=\"${VERSION}\" ${XINERAMAFLAGS}
+CXXFLAGS = -std=c++20 -Wpedantic -Wall -Wextra -Wno-deprecated-declarations ${INCS} -D_DEFAULT_SOURCE -DVERSION=\"${VERSION}\" ${XINERAMAFLAGS} ${XRANDRFLAGS} ${XINPUT2FLAGS} ${XCBFLAGS} ${SHMBARFLAGS}
 LDFLAGS  = ${LIBS}
 
 DEBUG_CXXFLAGS = -fsanitize=address,undefined -g -Og
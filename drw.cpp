@@ -4,7 +4,13 @@
 
 #include <X11/Xft/Xft.h>
 #include <X11/Xlib.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
+#include <algorithm>
+#include <bit>
+#include <cstdint>
 #include <cstdio>
 #include <memory>
 #include <optional>
@@ -59,51 +65,33 @@ size_t utf8decode(const char* c, long* u, size_t clen) {
     return len;
 }
 
-const DisplayFont*
-getFirstFontWithSymbol(const std::vector<DisplayFont>& fFonts,
-                       const long utf8Codepoint) {
-    for (const auto& font : fFonts) {
-        if (font.doesCodepointExistInFont(utf8Codepoint)) {
-            return &font;
-        }
+/* Number of leading 7 bit characters, found 16 or 32 bytes at a time */
+size_t getAsciiPrefixLength(const std::string_view text) {
+    size_t length = 0;
+#if defined(__AVX2__)
+    for (; length + 32 <= text.size(); length += 32) {
+        const auto chunk = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(text.data() + length));
+        if (const uint32_t highBits = _mm256_movemask_epi8(chunk); highBits)
+            return length + std::countr_zero(highBits);
     }
-    return nullptr;
-}
-
-std::string_view
-getContiguousCharactersWithRenderer(const DisplayFont* renderingFont,
-                                    const std::vector<DisplayFont>& fonts,
-                                    const std::string_view text) {
-    size_t utf8StringLength = 0;
-    while (utf8StringLength < text.size()) {
-        long utf8Codepoint;
-
-        const auto suffix = text.substr(utf8StringLength);
-        const auto utf8CharLength =
-            utf8decode(suffix.data(), &utf8Codepoint, UTF_SIZ);
-
-        if (utf8StringLength > 0 &&
-            renderingFont != getFirstFontWithSymbol(fonts, utf8Codepoint)) {
-            break;
-        }
-
-        utf8StringLength += utf8CharLength;
+#endif
+#if defined(__SSE2__)
+    for (; length + 16 <= text.size(); length += 16) {
+        const auto chunk = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(text.data() + length));
+        if (const uint32_t highBits = _mm_movemask_epi8(chunk); highBits)
+            return length + std::countr_zero(highBits);
     }
-    return text.substr(0, utf8StringLength);
+#endif
+    while (length < text.size() && !(text[length] & 0x80))
+        length++;
+    return length;
 }
 
-std::string_view cropTextToExtent(const DisplayFont& renderingFont,
-                                  const std::string_view text,
-                                  const size_t targetExtent) {
-    // TODO: I think this is a bug, I've copied the behaviour from the original
-    // dwm for now what happens if the last char in 'text' is utf8 encoded?
-    for (auto view = text; !view.empty(); view.remove_suffix(1)) {
-        if (renderingFont.getTextExtent(view) <= targetExtent) {
-            return view;
-        }
-    }
-    return std::string_view{};
-}
+/* Shaped strings are kept until this many distinct strings have been seen,
+ * then the cache starts over: window titles can change without bound. */
+const size_t maxShapedTexts = 256;
 
 } // namespace
 
@@ -122,24 +110,89 @@ CursorFont::~CursorFont() {
 
 Cursor CursorFont::getXCursor() const { return *fCursor; }
 
-XColorScheme::XColorScheme(Display* display, const int screen,
-                           const ColorScheme& scheme) {
+Surface::Surface(Display* display, int screen, Drawable root, uint w, uint h,
+                 bool rasterize, bool isShared)
+    : fDisplay{display}, fScreen{screen},
+      fImage{rasterize ? RasterImage::create(display, screen, w, h, isShared)
+                       : nullptr},
+      fWidth{w}, fHeight{h} {
+
+    if (!fImage) {
+        fPixmap =
+            XCreatePixmap(display, root, w, h, DefaultDepth(display, screen));
+    }
+}
+
+Surface::Surface(Surface&& other)
+    : fDisplay{other.fDisplay}, fScreen{other.fScreen}, fPixmap{other.fPixmap},
+      fXftDraw{other.fXftDraw}, fImage{std::move(other.fImage)},
+      fWidth{other.fWidth}, fHeight{other.fHeight} {
+    other.fPixmap = None;
+    other.fXftDraw = nullptr;
+}
+
+Surface::~Surface() {
+    if (fXftDraw) {
+        XftDrawDestroy(fXftDraw);
+    }
+    if (fPixmap) {
+        XFreePixmap(fDisplay, fPixmap);
+    }
+}
+
+Drawable Surface::getXDrawable() const { return fPixmap; }
+
+XftDraw* Surface::getXftDraw() const {
+    if (!fXftDraw) {
+        fXftDraw = XftDrawCreate(fDisplay, fPixmap,
+                                 DefaultVisual(fDisplay, fScreen),
+                                 DefaultColormap(fDisplay, fScreen));
+    }
+    return fXftDraw;
+}
+
+RasterImage* Surface::getRasterImage() const { return fImage.get(); }
 
-    const auto defaultVisual = DefaultVisual(display, screen);
-    const auto defaultColormap = DefaultColormap(display, screen);
+uint Surface::getWidth() const { return fWidth; }
 
-    if (!XftColorAllocName(display, defaultVisual, defaultColormap,
-                           scheme.foreground.data(), &foreground) ||
-        !XftColorAllocName(display, defaultVisual, defaultColormap,
-                           scheme.background.data(), &background) ||
-        !XftColorAllocName(display, defaultVisual, defaultColormap,
-                           scheme.border.data(), &border)) {
+uint Surface::getHeight() const { return fHeight; }
+
+ColorPool::ColorPool(Display* display, const int screen)
+    : fDisplay{display}, fScreen{screen} {}
+
+ColorPool::~ColorPool() {
+    for (auto& [rgba, color] : fColors) {
+        XftColorFree(fDisplay, DefaultVisual(fDisplay, fScreen),
+                     DefaultColormap(fDisplay, fScreen), &color);
+    }
+}
 
+const XftColor* ColorPool::getColor(const std::string& name) {
+    /* "#rrggbb" is parsed without a round trip, only named colors need the
+     * server's color database */
+    XRenderColor value;
+    if (!XRenderParseColor(fDisplay, const_cast<char*>(name.data()), &value))
+        die("error, cannot parse color '%s'", name.data());
+
+    const uint64_t rgba = static_cast<uint64_t>(value.red) << 48 |
+                          static_cast<uint64_t>(value.green) << 32 |
+                          static_cast<uint64_t>(value.blue) << 16 | value.alpha;
+    if (auto pooled = fColors.find(rgba); pooled != fColors.end())
+        return &pooled->second;
+
+    XftColor color;
+    if (!XftColorAllocValue(fDisplay, DefaultVisual(fDisplay, fScreen),
+                            DefaultColormap(fDisplay, fScreen), &value,
+                            &color)) {
         die("error, color allocation failure");
     }
+    return &fColors.emplace(rgba, color).first->second;
 }
 
 void DisplayFont::dieIfFontIsColored() const {
+    if (fAllowColor)
+        return; /* color glyphs are rasterized without Xft, see GlyphAtlas */
+
     /* Do not allow using color fonts. This is a workaround for a BadLength
      * error from Xft with color glyphs. Modelled on the Xterm workaround. See
      * https://bugzilla.redhat.com/show_bug.cgi?id=1498269
@@ -154,9 +207,10 @@ void DisplayFont::dieIfFontIsColored() const {
     }
 }
 
-DisplayFont::DisplayFont(Display* display, FcPattern* pattern)
+DisplayFont::DisplayFont(Display* display, FcPattern* pattern,
+                         const bool allowColor)
     : fDisplay{display}, fXfont{XftFontOpenPattern(display, pattern)},
-      fPattern{nullptr} {
+      fPattern{nullptr}, fAllowColor{allowColor} {
 
     if (!fXfont)
         die("error, cannot load font from pattern:");
@@ -165,9 +219,9 @@ DisplayFont::DisplayFont(Display* display, FcPattern* pattern)
 }
 
 DisplayFont::DisplayFont(Display* display, const int screen,
-                         const char* fontname)
+                         const char* fontname, const bool allowColor)
     : fDisplay{display}, fXfont{XftFontOpenName(display, screen, fontname)},
-      fPattern{FcNameParse((FcChar8*)fontname)} {
+      fPattern{FcNameParse((FcChar8*)fontname)}, fAllowColor{allowColor} {
 
     /* Using the pattern found at font->xfont->pattern does not yield the
      * same substitution results as using the pattern returned by
@@ -183,7 +237,8 @@ DisplayFont::DisplayFont(Display* display, const int screen,
 }
 
 DisplayFont::DisplayFont(DisplayFont&& other)
-    : fDisplay{other.fDisplay}, fXfont{other.fXfont}, fPattern{other.fPattern} {
+    : fDisplay{other.fDisplay}, fXfont{other.fXfont}, fPattern{other.fPattern},
+      fAllowColor{other.fAllowColor} {
 
     other.fPattern = nullptr;
     other.fXfont = nullptr;
@@ -214,7 +269,8 @@ DisplayFont::generateDerivedFontWithCodepoint(const int screen,
     auto* fcPattern = FcPatternDuplicate(fPattern);
     FcPatternAddCharSet(fcPattern, FC_CHARSET, fcCharSet);
     FcPatternAddBool(fcPattern, FC_SCALABLE, FcTrue);
-    FcPatternAddBool(fcPattern, FC_COLOR, FcFalse);
+    if (!fAllowColor)
+        FcPatternAddBool(fcPattern, FC_COLOR, FcFalse);
 
     FcConfigSubstitute(nullptr, fcPattern, FcMatchPattern);
     FcDefaultSubstitute(fcPattern);
@@ -228,7 +284,7 @@ DisplayFont::generateDerivedFontWithCodepoint(const int screen,
     if (!match)
         die("Match fail: TODO: figure out what should happen here");
 
-    if (DisplayFont newFont{fDisplay, match};
+    if (DisplayFont newFont{fDisplay, match, fAllowColor};
         newFont.doesCodepointExistInFont(utf8Codepoint)) {
         return newFont;
     }
@@ -241,55 +297,64 @@ uint DisplayFont::getHeight() const { return fXfont->ascent + fXfont->descent; }
 
 XftFont* DisplayFont::getXFont() const { return fXfont; };
 
-uint DisplayFont::getTextExtent(const std::string_view text) const {
-    if (text.empty())
-        return 0;
-
-    XGlyphInfo extent;
-    XftTextExtentsUtf8(fDisplay, fXfont, (XftChar8*)text.data(), text.size(),
-                       &extent);
+Drw::Drw(Display* display, int screen, Window root)
+    : fDisplay{display}, fScreen{screen}, fRoot{root},
+      fGC{XCreateGC(display, root, 0, nullptr)},
+      fRasterize{RasterImage::isSupported(display, screen)},
+      fColors{display, screen} {
 
-    return extent.xOff;
+    XSetLineAttributes(display, fGC, 1, LineSolid, CapButt, JoinMiter);
 }
 
-Drw::Drw(Display* display, int screen, Window root, uint w, uint h)
-    : fWidth{w}, fHeight{h}, fDisplay{display}, fScreen{screen}, fRoot{root},
-      fDrawable{
-          XCreatePixmap(display, root, w, h, DefaultDepth(display, screen))},
-      fGC{XCreateGC(display, root, 0, nullptr)} {
+Drw::~Drw() { XFreeGC(fDisplay, fGC); }
 
-    XSetLineAttributes(display, fGC, 1, LineSolid, CapButt, JoinMiter);
+Surface Drw::createSurface(const uint w, const uint h,
+                           const bool isShared) const {
+    return {fDisplay, fScreen, fRoot, w, h, fRasterize, isShared};
 }
 
-Drw::~Drw() {
-    XFreePixmap(fDisplay, fDrawable);
-    XFreeGC(fDisplay, fGC);
+void Drw::setSurface(const Surface& surface) {
+    if (fSurface != &surface)
+        flushText();
+    fSurface = &surface;
 }
 
-void Drw::resize(const uint w, const uint h) {
-    fWidth = w;
-    fHeight = h;
-
-    if (fDrawable) {
-        XFreePixmap(fDisplay, fDrawable);
-    }
-    fDrawable = XCreatePixmap(fDisplay, fRoot, fWidth, fHeight,
-                              DefaultDepth(fDisplay, fScreen));
+void Drw::releaseSurface(const Surface& surface) {
+    if (fSurface != &surface)
+        return;
+    flushText();
+    fSurface = nullptr;
 }
 
 const std::vector<DisplayFont>&
 Drw::createFontSet(const std::vector<std::string>& fontNames) {
     for (const auto& fontName : fontNames) {
-        fFonts.emplace_back(fDisplay, fScreen, fontName.data());
+        fFonts.emplace_back(fDisplay, fScreen, fontName.data(), fRasterize);
     }
+    if (!fFonts.empty())
+        cachePrimaryAsciiGlyphs();
     return fFonts;
 }
 
-Theme<XColorScheme> Drw::parseTheme(const Theme<ColorScheme>& scheme) const {
+XColorScheme Drw::parseScheme(const ColorScheme& scheme) {
     return {
-        .normal = {fDisplay, fScreen, scheme.normal},
-        .selected = {fDisplay, fScreen, scheme.selected},
+        .foreground = fColors.getColor(scheme.foreground),
+        .background = fColors.getColor(scheme.background),
+        .border = fColors.getColor(scheme.border),
+    };
+}
+
+Theme<XColorScheme> Drw::parseTheme(const Theme<ColorScheme>& scheme) {
+    Theme<XColorScheme> theme{
+        .normal = parseScheme(scheme.normal),
+        .selected = parseScheme(scheme.selected),
+        .urgent = parseScheme(scheme.urgent),
     };
+    for (const auto& tag : scheme.tags) {
+        theme.tags.push_back(tag ? std::optional{parseScheme(*tag)}
+                                 : std::nullopt);
+    }
+    return theme;
 }
 
 uint Drw::getPrimaryFontHeight() const { return fFonts.at(0).getHeight(); }
@@ -299,18 +364,26 @@ const std::vector<DisplayFont>& Drw::getFontset() const { return fFonts; }
 void Drw::setScheme(const XColorScheme& scheme) { fScheme = scheme; }
 
 void Drw::renderRect(const int x, const int y, const uint w, const uint h,
-                     const bool filled, const bool invert) const {
-    if (!fScheme)
+                     const bool filled, const bool invert) {
+    if (!fScheme || !fSurface)
         return;
 
-    XSetForeground(fDisplay, fGC,
-                   invert ? fScheme->background.pixel
-                          : fScheme->foreground.pixel);
+    const Rect area{x, y, static_cast<int>(w), static_cast<int>(h)};
+    const auto pixel =
+        invert ? fScheme->background->pixel : fScheme->foreground->pixel;
+    flushTextOverlapping(area);
 
     if (filled) {
-        XFillRectangle(fDisplay, fDrawable, fGC, x, y, w, h);
+        fillRect(area, pixel);
+    } else if (auto* image = fSurface->getRasterImage(); image) {
+        image->fill({x, y, area.width, 1}, pixel);
+        image->fill({x, y + area.height - 1, area.width, 1}, pixel);
+        image->fill({x, y, 1, area.height}, pixel);
+        image->fill({x + area.width - 1, y, 1, area.height}, pixel);
     } else {
-        XDrawRectangle(fDisplay, fDrawable, fGC, x, y, w - 1, h - 1);
+        XSetForeground(fDisplay, fGC, pixel);
+        XDrawRectangle(fDisplay, fSurface->getXDrawable(), fGC, x, y, w - 1,
+                       h - 1);
     }
 }
 
@@ -318,84 +391,218 @@ int Drw::renderText(int x, const int y, uint w, uint h, const uint lpad,
                     std::string_view text, const bool invert) {
 
     bool shouldRender = x || y || w || h;
-    if ((shouldRender && !fScheme) || text.empty() || fFonts.empty()) {
+    if ((shouldRender && (!fScheme || !fSurface)) || text.empty() ||
+        fFonts.empty()) {
         return 0;
     }
 
-    XftDraw* xftDrawer = nullptr;
-    if (shouldRender) {
-        XSetForeground(fDisplay, fGC,
-                       invert ? fScheme->foreground.pixel
-                              : fScheme->background.pixel);
-        XFillRectangle(fDisplay, fDrawable, fGC, x, y, w, h);
-        xftDrawer =
-            XftDrawCreate(fDisplay, fDrawable, DefaultVisual(fDisplay, fScreen),
-                          DefaultColormap(fDisplay, fScreen));
-        x += lpad;
-        w -= lpad;
-    } else {
-        w = ~w;
+    const auto& shapedText = shapeText(text);
+    if (!shouldRender)
+        return shapedText.width;
+
+    /* Glyphs are queued and drawn in a single request per color by flushText,
+     * anything queued beneath this box must be drawn before it is filled. */
+    const Rect area{x, y, static_cast<int>(w), static_cast<int>(h)};
+    flushTextOverlapping(area);
+    fillRect(area,
+             invert ? fScheme->foreground->pixel : fScheme->background->pixel);
+    x += lpad;
+    w -= lpad;
+
+    const auto* color = invert ? fScheme->background : fScheme->foreground;
+    auto pending = std::ranges::find_if(fPendingText, [&](const auto& batch) {
+        return batch.color == color; /* pooled, equal colors are shared */
+    });
+    if (pending == fPendingText.end())
+        pending = fPendingText.insert(pending, {color, {}});
+
+    for (const auto& glyph : shapedText.glyphs) {
+        if (static_cast<uint>(glyph.x + glyph.advance) > w)
+            break; // TODO: render elipsis if the text is cropped
+
+        auto* xfont = fFonts[glyph.font].getXFont();
+        pending->glyphs.push_back({
+            .font = xfont,
+            .glyph = glyph.index,
+            .x = static_cast<short>(x + glyph.x),
+            .y = static_cast<short>(
+                y + (h - fFonts[glyph.font].getHeight()) / 2 + xfont->ascent),
+        });
     }
+    fPendingTextAreas.push_back(area);
 
-    while (!text.empty()) {
-        long utf8Codepoint;
-        utf8decode(text.data(), &utf8Codepoint, UTF_SIZ);
-
-        const auto* renderingFont =
-            getFirstFontWithSymbol(fFonts, utf8Codepoint);
-
-        if (!renderingFont) {
-            // Make a new font to render this character
-            // NOTE: don't mutate fFonts past this point
-            auto newFont = fFonts[0].generateDerivedFontWithCodepoint(
-                fScreen, utf8Codepoint);
-            if (newFont) {
-                renderingFont = &fFonts.emplace_back(std::move(*newFont));
-            } else {
-                renderingFont = &(*fFonts.begin());
-            }
+    return x + w;
+}
+
+void Drw::copySurface(const Surface& source, const int x, const int y) {
+    if (!fSurface)
+        return;
+
+    const Rect area{x, y, static_cast<int>(source.getWidth()),
+                    static_cast<int>(source.getHeight())};
+    flushTextOverlapping(area);
+
+    auto* sourceImage = source.getRasterImage();
+    if (auto* image = fSurface->getRasterImage(); image && sourceImage) {
+        image->copy(*sourceImage, x, y);
+    } else if (sourceImage) {
+        sourceImage->put(fSurface->getXDrawable(), fGC,
+                         {0, 0, area.width, area.height}, x, y);
+    } else if (!image) {
+        XCopyArea(fDisplay, source.getXDrawable(), fSurface->getXDrawable(),
+                  fGC, 0, 0, source.getWidth(), source.getHeight(), x, y);
+    }
+}
+
+int Drw::getTextWidth(const std::string_view text) {
+    return renderText(0, 0, 0, 0, 0, text, 0);
+}
+
+void Drw::map(Window win, const std::vector<Rect>& areas) {
+    if (!fSurface)
+        return;
+
+    /* No sync: the copies go out with the next flush of the event loop,
+     * together with those of every other bar drawn in the meantime. */
+    flushText();
+    for (const auto& area : areas) {
+        if (auto* image = fSurface->getRasterImage(); image) {
+            image->put(win, fGC, area, area.x, area.y);
+        } else {
+            XCopyArea(fDisplay, fSurface->getXDrawable(), win, fGC, area.x,
+                      area.y, area.width, area.height, area.x, area.y);
         }
+    }
+    fSurface = nullptr; /* mapping ends a frame, the next one sets its own */
+}
 
-        const auto textToRender =
-            getContiguousCharactersWithRenderer(renderingFont, fFonts, text);
-        text.remove_prefix(textToRender.size());
-
-        const auto croppedTextToRender =
-            cropTextToExtent(*renderingFont, textToRender, w);
-
-        if (!croppedTextToRender.empty()) {
-            // TODO: render elipsis if textToRender != croppedTextToRender
-
-            if (shouldRender) {
-                const auto ty = y + (h - renderingFont->getHeight()) / 2 +
-                                renderingFont->getXFont()->ascent;
-                XftDrawStringUtf8(xftDrawer,
-                                  invert ? &fScheme->background
-                                         : &fScheme->foreground,
-                                  renderingFont->getXFont(), x, ty,
-                                  (XftChar8*)croppedTextToRender.data(),
-                                  croppedTextToRender.size());
-            }
+void Drw::fillRect(const Rect& area, const unsigned long pixel) {
+    if (auto* image = fSurface->getRasterImage(); image) {
+        image->fill(area, pixel);
+    } else {
+        XSetForeground(fDisplay, fGC, pixel);
+        XFillRectangle(fDisplay, fSurface->getXDrawable(), fGC, area.x, area.y,
+                       area.width, area.height);
+    }
+}
 
-            const auto finalExtent =
-                renderingFont->getTextExtent(croppedTextToRender);
-            x += finalExtent;
-            w -= finalExtent;
+size_t Drw::getFontIndexWithCodepoint(const long utf8Codepoint) {
+    for (size_t i = 0; i < fFonts.size(); i++) {
+        if (fFonts[i].doesCodepointExistInFont(utf8Codepoint)) {
+            return i;
         }
     }
 
-    if (xftDrawer) {
-        XftDrawDestroy(xftDrawer);
+    // Make a new font to render this character
+    if (auto newFont =
+            fFonts[0].generateDerivedFontWithCodepoint(fScreen, utf8Codepoint);
+        newFont) {
+        fFonts.emplace_back(std::move(*newFont));
+        return fFonts.size() - 1;
     }
+    return 0;
+}
+
+int Drw::getGlyphAdvance(XftFont* xfont, FT_UInt glyph) {
+    /* Xft would upload the glyph to measure it, which is exactly what
+     * rasterizing avoids */
+    if (fRasterize)
+        return fAtlas.getGlyph(xfont, glyph).advance;
 
-    return x + (shouldRender ? w : 0);
+    XGlyphInfo extent;
+    XftGlyphExtents(fDisplay, xfont, &glyph, 1, &extent);
+    return extent.xOff;
 }
 
-int Drw::getTextWidth(const std::string_view text) {
-    return renderText(0, 0, 0, 0, 0, text, 0);
+void Drw::cachePrimaryAsciiGlyphs() {
+    auto* xfont = fFonts[0].getXFont();
+    for (long c = 0; c < static_cast<long>(fAsciiGlyphs.size()); c++) {
+        auto& glyph = fAsciiGlyphs[c];
+        glyph.index = XftCharIndex(fDisplay, xfont, c);
+        glyph.advance = glyph.index ? getGlyphAdvance(xfont, glyph.index) : 0;
+    }
 }
 
-void Drw::map(Window win, int x, int y, uint w, uint h) const {
-    XCopyArea(fDisplay, fDrawable, win, fGC, x, y, w, h, x, y);
-    XSync(fDisplay, False);
+const ShapedText& Drw::shapeText(std::string_view text) {
+    if (auto cached = fShapedTexts.find(text); cached != fShapedTexts.end())
+        return cached->second;
+
+    if (fShapedTexts.size() >= maxShapedTexts)
+        fShapedTexts.clear();
+
+    auto& shapedText = fShapedTexts[std::string{text}];
+    const auto appendGlyph = [&](size_t font, FT_UInt index, int advance) {
+        shapedText.glyphs.push_back({
+            .font = font,
+            .index = index,
+            .x = shapedText.width,
+            .advance = advance,
+        });
+        shapedText.width += advance;
+    };
+
+    size_t asciiLength = 0;
+    while (!text.empty()) {
+        /* ASCII the primary font covers needs neither decoding nor a lookup */
+        if (asciiLength == 0)
+            asciiLength = getAsciiPrefixLength(text);
+        size_t covered = 0;
+        for (; covered < asciiLength; covered++) {
+            const auto& glyph =
+                fAsciiGlyphs[static_cast<unsigned char>(text[covered])];
+            if (!glyph.index)
+                break;
+            appendGlyph(0, glyph.index, glyph.advance);
+        }
+        text.remove_prefix(covered);
+        asciiLength -= covered;
+        if (text.empty())
+            break;
+
+        long utf8Codepoint;
+        const auto utf8CharLength =
+            utf8decode(text.data(), &utf8Codepoint,
+                       std::min<size_t>(text.size(), UTF_SIZ));
+        /* a truncated sequence at the end of the text is one invalid char */
+        text.remove_prefix(utf8CharLength ? utf8CharLength : text.size());
+        if (asciiLength)
+            asciiLength--;
+
+        const auto fontIndex = getFontIndexWithCodepoint(utf8Codepoint);
+        auto* xfont = fFonts[fontIndex].getXFont();
+        const auto glyph = XftCharIndex(fDisplay, xfont, utf8Codepoint);
+        appendGlyph(fontIndex, glyph, getGlyphAdvance(xfont, glyph));
+    }
+    return shapedText;
+}
+
+void Drw::flushText() {
+    if (fSurface) {
+        auto* image = fSurface->getRasterImage();
+        for (auto& pending : fPendingText) {
+            if (pending.glyphs.empty())
+                continue;
+            if (image) {
+                for (const auto& spec : pending.glyphs) {
+                    image->drawGlyph(fAtlas,
+                                     fAtlas.getGlyph(spec.font, spec.glyph),
+                                     spec.x, spec.y, pending.color->color);
+                }
+            } else {
+                XftDrawGlyphFontSpec(fSurface->getXftDraw(), pending.color,
+                                     pending.glyphs.data(),
+                                     pending.glyphs.size());
+            }
+            pending.glyphs.clear();
+        }
+    }
+    fPendingTextAreas.clear();
+}
+
+void Drw::flushTextOverlapping(const Rect& area) {
+    if (std::ranges::any_of(fPendingTextAreas, [&](const auto& pendingArea) {
+            return pendingArea.getIntersection(area) > 0;
+        })) {
+        flushText();
+    }
 }
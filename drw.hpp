@@ -1,11 +1,19 @@
 /* See LICENSE file for copyright and license details. */
 #pragma once
 
+#include "raster.hpp"
+#include "util.hpp"
+
 #include <X11/Xft/Xft.h>
 #include <X11/Xlib.h>
 
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
 #include <optional>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -22,29 +30,70 @@ class CursorFont {
     std::optional<Cursor> fCursor;
 };
 
+/* Pixels that are kept between renders: either a server-side pixmap or, when
+ * rasterizing, a client-side image */
+class Surface {
+  public:
+    Surface(Display*, int screen, Drawable root, uint w, uint h,
+            bool rasterize = false, bool isShared = true);
+    Surface(Surface&&);
+    ~Surface();
+
+    Drawable getXDrawable() const;
+    XftDraw* getXftDraw() const;
+    RasterImage* getRasterImage() const;
+    uint getWidth() const;
+    uint getHeight() const;
+
+  private:
+    Display* fDisplay;
+    int fScreen;
+    Pixmap fPixmap = None;
+    mutable XftDraw* fXftDraw = nullptr;
+    std::unique_ptr<RasterImage> fImage;
+    uint fWidth, fHeight;
+};
+
 struct ColorScheme {
     std::string foreground;
     std::string background;
     std::string border;
 };
 
-struct XColorScheme {
-    XColorScheme(Display*, int screen, const ColorScheme&);
+/* Colors allocated once per distinct RGBA value and shared by every scheme
+ * using them, so switching between schemes never talks to the server */
+class ColorPool {
+  public:
+    ColorPool(Display*, int screen);
+    ColorPool(const ColorPool&) = delete;
+    ~ColorPool();
 
-    XftColor foreground;
-    XftColor background;
-    XftColor border;
+    const XftColor* getColor(const std::string& name);
+
+  private:
+    Display* fDisplay;
+    int fScreen;
+    std::map<uint64_t, XftColor> fColors; /* keyed by packed RGBA */
+};
+
+struct XColorScheme {
+    const XftColor* foreground;
+    const XftColor* background;
+    const XftColor* border;
 };
 
 template <typename Scheme> struct Theme {
     Scheme normal;
     Scheme selected;
+    Scheme urgent;
+    std::vector<std::optional<Scheme>> tags{}; /* replaces selected, by tag */
 };
 
 class DisplayFont {
   public:
-    DisplayFont(Display*, int screen, const char* fontName);
-    DisplayFont(Display*, FcPattern*);
+    DisplayFont(Display*, int screen, const char* fontName,
+                bool allowColor = false);
+    DisplayFont(Display*, FcPattern*, bool allowColor = false);
     DisplayFont(DisplayFont&&);
     ~DisplayFont();
 
@@ -54,7 +103,6 @@ class DisplayFont {
     generateDerivedFontWithCodepoint(int screen, long utf8Codepoint) const;
 
     uint getHeight() const;
-    uint getTextExtent(std::string_view) const;
     XftFont* getXFont() const;
 
   private:
@@ -63,14 +111,32 @@ class DisplayFont {
     Display* fDisplay;
     XftFont* fXfont;
     FcPattern* fPattern;
+    bool fAllowColor;
+};
+
+/* Text converted to glyphs once, positioned relative to the pen origin */
+struct ShapedText {
+    struct Glyph {
+        size_t font; /* index into the fontset */
+        FT_UInt index;
+        int x, advance;
+    };
+
+    std::vector<Glyph> glyphs;
+    int width = 0;
 };
 
 class Drw {
   public:
-    Drw(Display* dpy, int screen, Window win, uint w, uint h);
+    Drw(Display* dpy, int screen, Window win);
     ~Drw();
 
-    void resize(uint w, uint h);
+    /* Surfaces that are only copied into others, never mapped, need not be
+     * shared with the server */
+    Surface createSurface(uint w, uint h, bool isShared = true) const;
+    void setSurface(const Surface&);
+    /* Must be called before a surface that may be current is destroyed */
+    void releaseSurface(const Surface&);
 
     const std::vector<DisplayFont>&
     createFontSet(const std::vector<std::string>& fontNames);
@@ -78,25 +144,51 @@ class Drw {
     uint getPrimaryFontHeight() const;
     const std::vector<DisplayFont>& getFontset() const;
 
-    Theme<XColorScheme> parseTheme(const Theme<ColorScheme>&) const;
+    XColorScheme parseScheme(const ColorScheme&);
+    Theme<XColorScheme> parseTheme(const Theme<ColorScheme>&);
     void setScheme(const XColorScheme&);
 
     int getTextWidth(std::string_view);
     void renderRect(int x, int y, uint w, uint h, bool filled,
-                    bool invert) const;
+                    bool invert);
     int renderText(int x, int y, uint w, uint h, uint lpad, std::string_view,
                    bool invert);
+    void copySurface(const Surface&, int x, int y);
 
-    void map(Window win, int x, int y, uint w, uint h) const;
+    void map(Window win, const std::vector<Rect>& areas);
 
   private:
-    uint fWidth, fHeight;
+    struct AsciiGlyph {
+        FT_UInt index; /* 0 when the font lacks the character */
+        int advance;
+    };
+
+    struct PendingText {
+        const XftColor* color;
+        std::vector<XftGlyphFontSpec> glyphs;
+    };
+
+    size_t getFontIndexWithCodepoint(long utf8Codepoint);
+    int getGlyphAdvance(XftFont*, FT_UInt glyph);
+    void cachePrimaryAsciiGlyphs();
+    const ShapedText& shapeText(std::string_view);
+    void fillRect(const Rect&, unsigned long pixel);
+    void flushText();
+    void flushTextOverlapping(const Rect&);
+
     Display* fDisplay;
     int fScreen;
     Window fRoot;
-    Drawable fDrawable;
+    const Surface* fSurface = nullptr;
     GC fGC;
+    bool fRasterize; /* render client-side, see RasterImage */
+    GlyphAtlas fAtlas;
+    ColorPool fColors;
     std::optional<XColorScheme> fScheme;
 
     std::vector<DisplayFont> fFonts;
+    std::array<AsciiGlyph, 128> fAsciiGlyphs{}; /* of the primary font */
+    std::map<std::string, ShapedText, std::less<>> fShapedTexts;
+    std::vector<PendingText> fPendingText; /* one batch per color */
+    std::vector<Rect> fPendingTextAreas;
 };
@@ -0,0 +1,303 @@
+/* See LICENSE file for copyright and license details. */
+#include "drw.hpp"
+#include "util.hpp"
+
+#include <X11/Xlib.h>
+#include <csignal>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char defaultFont[] = "monospace:size=10";
+const int screenWidth = 1920;
+const int defaultCalls = 20000;
+
+struct Corpus {
+    const char* name;
+    std::vector<std::string> lines;
+};
+
+struct Result {
+    double microsecondsPerCall;
+    double requestsPerCall;
+};
+
+/* An Xvfb of our own, so results don't depend on the running session */
+class PrivateServer {
+  public:
+    PrivateServer();
+    PrivateServer(const PrivateServer&) = delete;
+    ~PrivateServer();
+
+    const std::string& getDisplayName() const;
+
+  private:
+    pid_t fPid;
+    std::string fDisplayName;
+};
+
+PrivateServer::PrivateServer() {
+    int displayPipe[2];
+    if (pipe(displayPipe) < 0)
+        die("drw_bench: pipe:");
+
+    if ((fPid = fork()) < 0)
+        die("drw_bench: fork:");
+    if (fPid == 0) {
+        close(displayPipe[0]);
+        const auto displayFd = std::to_string(displayPipe[1]);
+        const auto screen = std::to_string(screenWidth) + "x1080x24";
+        execlp("Xvfb", "Xvfb", "-displayfd", displayFd.data(), "-nolisten",
+               "tcp", "-screen", "0", screen.data(), nullptr);
+        _exit(127);
+    }
+    close(displayPipe[1]);
+
+    /* Xvfb writes the display number it picked once it accepts clients */
+    char number[16] = {};
+    size_t length = 0;
+    while (length < sizeof(number) - 1 &&
+           read(displayPipe[0], number + length, 1) == 1 &&
+           number[length] != '\n') {
+        length++;
+    }
+    close(displayPipe[0]);
+    number[length] = '\0';
+    if (length == 0)
+        die("drw_bench: cannot start Xvfb");
+
+    fDisplayName = std::string{":"} + number;
+}
+
+PrivateServer::~PrivateServer() {
+    kill(fPid, SIGTERM);
+    waitpid(fPid, nullptr, 0);
+}
+
+const std::string& PrivateServer::getDisplayName() const {
+    return fDisplayName;
+}
+
+/* Every corpus stays below the shaped text cache limit, lines are generated
+ * so that consecutive calls never see the same string twice */
+std::vector<std::string> generate(const char* format,
+                                  const std::vector<const char*>& words,
+                                  const int count) {
+    std::vector<std::string> lines;
+    for (int i = 0; i < count; i++) {
+        char line[512];
+        snprintf(line, sizeof(line), format, words[i % words.size()],
+                 words[(i * 7 + 3) % words.size()], i);
+        lines.emplace_back(line);
+    }
+    return lines;
+}
+
+std::vector<Corpus> createCorpora() {
+    return {
+        {"ascii",
+         generate("cpu %s | mem %s | net %d kB/s | bat 87%% | 2026-10-16 "
+                  "14:03:22",
+                  {"3%", "12%", "47%", "99%", "1.2G", "3.4G", "7.9G"}, 200)},
+        {"latin",
+         generate("%s — Überprüfung der Änderungen für „%s“ (%d) · Mozilla "
+                  "Firefox",
+                  {"Rédaction", "Café crème", "Ångström", "Smørrebrød",
+                   "Żółć", "Ça déménage", "Niño"},
+                  200)},
+        {"cjk",
+         generate("%s・%s 第%d話 — 東京の天気予報",
+                  {"日本語", "中文字符", "한국어", "漢字かな交じり", "繁體中文",
+                   "简体中文", "ひらがな"},
+                  200)},
+        {"emoji",
+         generate("%s build %s #%d ✓ ⚠ → ★ ♫ ☀",
+                  {"🔋", "📶", "🎵", "🔥", "✅", "❌", "🌧"}, 200)},
+    };
+}
+
+template <typename Call>
+Result measure(Display* display, const int calls, const Call& call) {
+    XSync(display, False);
+    const auto firstRequest = NextRequest(display);
+    const auto start = Clock::now();
+
+    for (int i = 0; i < calls; i++)
+        call(i);
+    const auto requests = NextRequest(display) - firstRequest;
+    XSync(display, False); /* include the time the server spends drawing */
+
+    const std::chrono::duration<double, std::micro> elapsed =
+        Clock::now() - start;
+    return {elapsed.count() / calls, static_cast<double>(requests) / calls};
+}
+
+void report(const char* corpus, const char* name, const Result& result) {
+    printf("%-8s %-12s %10.2f %10.2f\n", corpus, name,
+           result.microsecondsPerCall, result.requestsPerCall);
+}
+
+void benchmark(Display* display, const int screen, const Window window,
+               const std::vector<std::string>& fonts, const Corpus& corpus,
+               const int calls) {
+    const auto root = RootWindow(display, screen);
+    const auto& lines = corpus.lines;
+
+    /* A new Drw per corpus, so fallback fonts are matched from scratch */
+    Drw drw{display, screen, root};
+    const auto fontStart = Clock::now();
+    drw.createFontSet(fonts);
+    const auto fontSetTime = Clock::now() - fontStart;
+
+    drw.setScheme(drw.parseScheme({"#bbbbbb", "#222222", "#444444"}));
+    const auto barHeight = drw.getPrimaryFontHeight() + 2;
+    const auto bar = drw.createSurface(screenWidth, barHeight);
+    drw.setSurface(bar);
+
+    /* The first pass shapes every line and looks up fallback fonts, the
+     * second only hits the caches. The difference is what fontconfig and
+     * font loading cost. */
+    const auto cold = measure(display, lines.size(), [&](const int i) {
+        drw.getTextWidth(lines[i]);
+    });
+    const auto warm = measure(display, lines.size(), [&](const int i) {
+        drw.getTextWidth(lines[i]);
+    });
+    const std::chrono::duration<double, std::milli> fontconfigTime =
+        fontSetTime + std::chrono::duration<double, std::micro>{
+                          (cold.microsecondsPerCall -
+                           warm.microsecondsPerCall) *
+                          lines.size()};
+
+    report(corpus.name, "width", measure(display, calls, [&](const int i) {
+               drw.getTextWidth(lines[i % lines.size()]);
+           }));
+    report(corpus.name, "render", measure(display, calls, [&](const int i) {
+               drw.renderText(0, 0, screenWidth, barHeight, 5,
+                              lines[i % lines.size()], false);
+               if (i == calls - 1)
+                   drw.map(window, {}); /* flush the last batch */
+           }));
+
+    /* A full row of text rendered from scratch every frame: status, tags,
+     * layout symbol and title. This is raw Drw throughput, not what
+     * Monitor::drawbar does any more. */
+    const std::array<std::string, 9> tags{"1", "2", "3", "4", "5",
+                                          "6", "7", "8", "9"};
+    report(corpus.name, "textrow", measure(display, calls, [&](const int i) {
+               drw.setSurface(bar); /* map releases it */
+               const auto& status = lines[i % lines.size()];
+               const auto& title = lines[(i + 1) % lines.size()];
+               const int statusWidth = drw.getTextWidth(status) + 2;
+               drw.renderText(screenWidth - statusWidth, 0, statusWidth,
+                              barHeight, 0, status, false);
+               int x = 0;
+               for (const auto& tag : tags) {
+                   const int w = drw.getTextWidth(tag) + 10;
+                   drw.renderText(x, 0, w, barHeight, 5, tag, false);
+                   x += w;
+               }
+               const int w = drw.getTextWidth("[]=") + 10;
+               drw.renderText(x, 0, w, barHeight, 5, "[]=", false);
+               x += w;
+               drw.renderText(x, 0, screenWidth - statusWidth - x, barHeight,
+                              5, title, false);
+               drw.map(window, {{0, 0, screenWidth,
+                                 static_cast<int>(barHeight)}});
+           }));
+
+    /* Replays Monitor::drawbar for a frame where the status and the title
+     * changed, keep it in step with dwm.cpp: tags and layout symbol are
+     * unchanged segments, the status is re-rendered into its block label
+     * and copied, the title is rendered and only those two areas mapped. */
+    const int lrpad = drw.getPrimaryFontHeight();
+    int tagsWidth = 0;
+    std::vector<Surface> tagLabels;
+    for (const auto& tag : tags) {
+        const int w = drw.getTextWidth(tag) + lrpad;
+        drw.setSurface(tagLabels.emplace_back(
+            drw.createSurface(w, barHeight, false)));
+        drw.renderText(0, 0, w, barHeight, lrpad / 2, tag, false);
+        tagsWidth += w;
+    }
+    for (const auto& label : tagLabels)
+        drw.releaseSurface(label);
+    const int titleX = tagsWidth + drw.getTextWidth("[]=") + lrpad;
+    std::optional<Surface> statusLabel;
+    report(corpus.name, "bar", measure(display, calls, [&](const int i) {
+               const auto& status = lines[i % lines.size()];
+               const auto& title = lines[(i + 1) % lines.size()];
+               const int statusWidth = drw.getTextWidth(status) + lrpad;
+               if (!statusLabel ||
+                   statusLabel->getWidth() != static_cast<uint>(statusWidth)) {
+                   if (statusLabel)
+                       drw.releaseSurface(*statusLabel);
+                   statusLabel.emplace(
+                       drw.createSurface(statusWidth, barHeight, false));
+               }
+               drw.setSurface(*statusLabel);
+               drw.renderText(0, 0, statusWidth, barHeight, lrpad / 2, status,
+                              false);
+
+               drw.setSurface(bar);
+               const int statusX = screenWidth - statusWidth;
+               drw.copySurface(*statusLabel, statusX, 0);
+               drw.renderText(titleX, 0, statusX - titleX, barHeight,
+                              lrpad / 2, title, false);
+               drw.map(window, {{titleX, 0, screenWidth - titleX,
+                                 static_cast<int>(barHeight)}});
+           }));
+    if (statusLabel)
+        drw.releaseSurface(*statusLabel);
+    printf("%-8s %-12s %10.2f ms\n", corpus.name, "fontconfig",
+           fontconfigTime.count());
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    int calls = defaultCalls;
+    std::vector<std::string> fonts;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp("-n", argv[i]) && i + 1 < argc)
+            calls = std::max(1, atoi(argv[++i]));
+        else if (argv[i][0] == '-')
+            die("usage: drw_bench [-n calls] [font ...]");
+        else
+            fonts.emplace_back(argv[i]);
+    }
+    if (fonts.empty())
+        fonts.emplace_back(defaultFont);
+
+    const PrivateServer server;
+    auto* display = XOpenDisplay(server.getDisplayName().data());
+    if (!display)
+        die("drw_bench: cannot open display %s",
+            server.getDisplayName().data());
+
+    const int screen = DefaultScreen(display);
+    const auto window = XCreateSimpleWindow(
+        display, RootWindow(display, screen), 0, 0, screenWidth, 64, 0, 0, 0);
+    XMapWindow(display, window);
+
+    printf("%-8s %-12s %10s %10s\n", "corpus", "case", "us/call",
+           "req/call");
+    for (const auto& corpus : createCorpora())
+        benchmark(display, screen, window, fonts, corpus, calls);
+
+    XDestroyWindow(display, window);
+    XCloseDisplay(display);
+    return EXIT_SUCCESS;
+}
@@ -22,6 +22,9 @@
  */
 
 #include "drw.hpp"
+#include "ipc.hpp"
+#include "loop.hpp"
+#include "snapshot.hpp"
 #include "util.hpp"
 #include "x.hpp"
 
@@ -34,16 +37,33 @@
 #ifdef XINERAMA
 #include <X11/extensions/Xinerama.h>
 #endif /* XINERAMA */
+#ifdef XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif /* XRANDR */
+#ifdef XINPUT2
+#include <X11/extensions/XInput2.h>
+#endif /* XINPUT2 */
+#ifdef XCB
+#include <X11/Xlib-xcb.h>
+#endif /* XCB */
 #include <X11/Xft/Xft.h>
 
 #include <algorithm>
 #include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdarg>
+#include <cstdlib>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <optional>
 #include <ranges>
+#include <span>
+#include <string>
 #include <string_view>
 #include <sys/wait.h>
+#include <unordered_map>
 
 /* macros */
 #define BUTTONMASK (ButtonPressMask | ButtonReleaseMask)
@@ -93,7 +113,45 @@ struct Button {
     uint click;
     uint mask;
     uint button;
-    std::function<void(uint)> action;
+    void (*action)(uint);
+};
+
+/* The configured buttons grouped by click region, sorted by button number and
+ * otherwise in configuration order, so a press only visits its own region */
+template <size_t N> class ButtonTable {
+  public:
+    constexpr explicit ButtonTable(const std::array<Button, N>& buttons)
+        : fButtons{buttons} {
+        for (size_t i = 1; i < N; i++) { /* insertion sort keeps the order */
+            for (size_t j = i; j > 0 && isBefore(fButtons[j], fButtons[j - 1]);
+                 j--)
+                std::swap(fButtons[j], fButtons[j - 1]);
+        }
+        for (uint click = 0, i = 0; click <= ClkLast; click++) {
+            while (i < N && fButtons[i].click < click)
+                i++;
+            fRegionStart[click] = i;
+        }
+    }
+
+    constexpr std::span<const Button> getRegion(uint click) const {
+        return std::span{fButtons}.subspan(
+            fRegionStart[click], fRegionStart[click + 1] - fRegionStart[click]);
+    }
+
+    constexpr std::span<const Button> find(uint click, uint button) const {
+        const auto [first, last] = std::ranges::equal_range(
+            getRegion(click), button, {}, &Button::button);
+        return {first, last};
+    }
+
+  private:
+    static constexpr bool isBefore(const Button& a, const Button& b) {
+        return a.click != b.click ? a.click < b.click : a.button < b.button;
+    }
+
+    std::array<Button, N> fButtons;
+    std::array<size_t, ClkLast + 1> fRegionStart{};
 };
 
 struct Key {
@@ -107,6 +165,11 @@ struct Layout {
     void (*arrange)(Monitor*);
 };
 
+struct StatusBlockRule {
+    const char* name;
+    std::optional<ColorScheme> colors; /* normal colors when empty */
+};
+
 struct Rule {
     const char* xclass;
     const char* instance;
@@ -160,6 +223,7 @@ class Client {
     void requestKill() const;
     bool sendXEvent(Atom proto) const;
     void unmanageAndDestroyX() const;
+    SnapshotClient getSnapshot() const;
 
   private:
     void applyCustomRules();
@@ -190,6 +254,62 @@ class Client {
     MutableXProperty<XA_ATOM> fXState;
 };
 
+/* A rectangle of the bar together with everything that decides its pixels. Two
+ * equal segments render identically, so unchanged segments are not redrawn. */
+struct BarSegment {
+    enum class Indicator { Hidden, Outline, Filled };
+
+    int x, width;
+    std::string text;
+    const XColorScheme* scheme;
+    const Surface* label = nullptr; /* pre-rendered text, if any */
+    uint lpad = 0;
+    bool invert = false;
+    Indicator indicator = Indicator::Hidden;
+
+    bool operator==(const BarSegment&) const = default;
+    bool overlaps(const BarSegment& other) const {
+        return x < other.x + other.width && other.x < x + width;
+    }
+};
+
+/* A part of the status text, measured and rendered only when it changes */
+struct StatusBlock {
+    std::string name; /* empty for the root window name */
+    XColorScheme scheme;
+    std::string text{};
+    int width = 0;
+    std::optional<Surface> label{};
+};
+
+/* Defers every arrange until the outermost batch ends, then arranges each
+ * monitor once */
+class ArrangeBatch {
+  public:
+    ArrangeBatch();
+    ArrangeBatch(const ArrangeBatch&) = delete;
+    ~ArrangeBatch();
+
+    static bool defer(Monitor*, bool shouldRestack);
+
+  private:
+    struct PendingArrange {
+        Monitor* monitor;
+        bool shouldRestack;
+    };
+
+    static inline int sDepth = 0;
+    static inline std::vector<PendingArrange> sPending;
+};
+
+/* Tags never change, so every way a tag can look is rendered once */
+struct TagLabel {
+    enum { Selected = 1 << 0, Urgent = 1 << 1, VariantLast = 1 << 2 };
+
+    int width;
+    std::array<std::optional<Surface>, VariantLast> variants{};
+};
+
 class Monitor {
   public:
     explicit Monitor(int num);
@@ -198,6 +318,9 @@ class Monitor {
 
     bool isSelectedMonitor() const;
     int getMonitorNumber() const;
+#ifdef XRANDR
+    void setMonitorNumber(int);
+#endif /* XRANDR */
     Client* getClientFromWindowID(Window) const;
 
     void incrementMasterCount(int amount);
@@ -220,13 +343,19 @@ class Monitor {
     void focus(Client* client = nullptr);
     void shiftFocusThroughStack(int direction);
     void zoomClientToMaster(Client*);
-    void restackClients() const;
+    /* firstSerial is where the moves that led to the restack started */
+    void restackClients(std::optional<unsigned long> firstSerial = {}) const;
     void arrangeClients(bool shouldRestack = true);
     void updateBarPosition();
+    void requestBarRedraw() const;
     void drawbar() const;
+    void damageBar(const Rect&);
+    void repaintBar();
+    void invalidateBar() const;
     void toggleBarRendering();
 
     void updateXClientList() const;
+    void appendSnapshot(SnapshotState&) const;
     void updateXGeometry() const;
 
     void monocle();
@@ -238,6 +367,7 @@ class Monitor {
     int fGapSize;      /* gaps between windows */
     Window fBarID = 0;
     Client* fSelected = nullptr;
+    Atom fOutputName = None; /* stable RandR identity */
 
   private:
     int fMonitorNumber;
@@ -251,6 +381,11 @@ class Monitor {
     std::vector<std::unique_ptr<Client>> fClients;
     std::vector<Client*> fStack;
     const Layout* fLayouts[2];
+    mutable std::vector<BarSegment> fBarSegments; /* last rendered bar */
+    mutable std::optional<Surface> fBarSurface;   /* its retained pixels */
+    DamageRegion fBarDamage;                      /* exposed, not repainted */
+    mutable std::optional<EventLoop::TimerID> fBarRedrawTimer;
+    mutable EventLoop::Clock::time_point fLastBarDraw;
 };
 
 /* function declarations */
@@ -283,7 +418,6 @@ void zoom();
 /* variables */
 char dwmClassHint[] = {'d', 'w', 'm', '+', '+', '\0'};
 const char broken[] = "broken";
-char stext[256];
 int screen;
 int screenWidth, screenHeight; /* X display screen geometry width, height */
 int barHeight, blw = 0;        /* bar geometry */
@@ -295,11 +429,39 @@ Atom wmatom[WMLast];
 int running = 1;
 std::optional<CursorTheme> cursors;
 std::optional<Theme<XColorScheme>> scheme;
+std::vector<TagLabel> tagLabels;
+std::vector<StatusBlock> statusBlocks;
 Display* dpy;
 Drw* drw;
+EventLoop eventLoop;
+std::unique_ptr<DatagramSocket> statusSocket;
+std::unique_ptr<DatagramSocket> commandSocket;
+std::unique_ptr<EventStream> eventStream;
+std::unique_ptr<SnapshotWriter> snapshotWriter;
+std::pair<int, Window> publishedFocus{-1, 0}; /* monitor and window */
+#ifdef XRANDR
+int randrEventBase = -1; /* unset without RandR 1.5 */
+#endif /* XRANDR */
+#ifdef XINPUT2
+int xiOpcode = -1; /* unset without XInput 2 */
+#endif /* XINPUT2 */
+std::optional<EventLoop::TimerID> displayUpdateTimer;
+bool screenResized = false; /* since the monitors were last updated */
+int pointerX, pointerY; /* as of the last event that reported it */
+RectIndex monitorIndex;  /* of the monitors' window areas */
+bool isMonitorIndexStale = true;
+/* [first, end) serials of our restacks whose crossing events are ignored,
+ * end being that of the NoOperation sent after them */
+std::deque<std::pair<unsigned long, unsigned long>> ignoredEnterSerials;
+std::optional<EventLoop::TimerID> enterFocusTimer;
+Window enteredWindow = 0; /* focused once enterFocusTimer expires */
+/* by keycode and clean modifiers, rebuilt by grabkeys */
+std::unordered_map<uint, std::vector<const Key*>> keyBindings;
+Monitor* lastPointMonitor = nullptr;
 
 std::vector<std::unique_ptr<Monitor>> allMonitors;
 Monitor* selmon;
+Monitor* highlightedMonitor = nullptr; /* drawn as selected by its bar */
 Window root, wmcheckwin;
 
 /* configuration, allows nested code to access above variables */
@@ -307,6 +469,8 @@ Window root, wmcheckwin;
 
 static_assert(tags.size() < 32);
 
+constexpr ButtonTable buttonTable{buttons};
+
 /* There's no way to check accesses to destroyed windows, thus those cases are
  * ignored (especially on UnmapNotify's). Other types of errors call Xlibs
  * default error handler, which may call exit. */
@@ -348,22 +512,44 @@ void updateNumLockMask() {
     XFreeModifiermap(modmap);
 }
 
+/* CLEANMASK only keeps the eight core modifier bits */
+uint getKeyBindingID(KeyCode code, uint state) {
+    return code << 8 | CLEANMASK(state);
+}
+
+/* Bindings match on the unshifted keysym of a keycode, so every keycode that
+ * produces it is grabbed and mapped to the bindings in configuration order */
 void grabkeys() {
     updateNumLockMask();
     const std::array<uint, 4> modifiers{0, LockMask, numlockmask,
                                         numlockmask | LockMask};
     XUngrabKey(dpy, AnyKey, AnyModifier, root);
+    keyBindings.clear();
+
+    int firstCode, lastCode, symbolsPerCode;
+    XDisplayKeycodes(dpy, &firstCode, &lastCode);
+    KeySym* symbols = XGetKeyboardMapping(dpy, firstCode,
+                                          lastCode - firstCode + 1,
+                                          &symbolsPerCode);
+    if (!symbols)
+        return;
 
-    for (const auto& key : keys) {
-        if (const auto code = XKeysymToKeycode(dpy, key.keysym); code) {
+    for (int code = firstCode; code <= lastCode; code++) {
+        const KeySym keysym = symbols[(code - firstCode) * symbolsPerCode];
+        for (const auto& key : keys) {
+            if (key.keysym != keysym)
+                continue;
+            keyBindings[getKeyBindingID(code, key.mod)].push_back(&key);
             for (const auto& modifier : modifiers) {
                 XGrabKey(dpy, code, key.mod | modifier, root, True,
                          GrabModeAsync, GrabModeAsync);
             }
         }
     }
+    XFree(symbols);
 }
 
+#ifndef XCB
 long getXStateProperty(Window window) {
     int format;
     long result = -1;
@@ -381,6 +567,7 @@ long getXStateProperty(Window window) {
     XFree(p);
     return result;
 }
+#endif /* XCB */
 
 Atom getXAtomProperty(Window window, Atom prop) {
     int actualFormatReturn;
@@ -431,6 +618,75 @@ int getrootptr(int* x, int* y) {
     return XQueryPointer(dpy, root, &dummy, &dummy, x, y, &di, &di, &dui);
 }
 
+/* Serials wrap around, a is earlier if it is less than half the range behind */
+bool isSerialBefore(unsigned long a, unsigned long b) {
+    return static_cast<long>(a - b) < 0;
+}
+
+/* Crossing events carry the serial of the last request the server processed,
+ * so those our requests caused are below that of a NoOperation sent after
+ * them. This replaces syncing and draining every EnterNotify. */
+void ignoreEnterEventsSince(unsigned long firstSerial) {
+    /* once we have read past a range and handled every queued event, none of
+     * its crossing events can still arrive */
+    const unsigned long lastRead = LastKnownRequestProcessed(dpy);
+    while (QLength(dpy) == 0 && !ignoredEnterSerials.empty() &&
+           !isSerialBefore(lastRead, ignoredEnterSerials.front().second))
+        ignoredEnterSerials.pop_front();
+    XNoOp(dpy);
+    ignoredEnterSerials.emplace_back(firstSerial, NextRequest(dpy) - 1);
+}
+
+bool isIgnoredEnterEvent(unsigned long serial) {
+    /* events arrive in serial order, ranges they have passed are done */
+    while (!ignoredEnterSerials.empty() &&
+           !isSerialBefore(serial, ignoredEnterSerials.front().second))
+        ignoredEnterSerials.pop_front();
+    return !ignoredEnterSerials.empty() &&
+           !isSerialBefore(serial, ignoredEnterSerials.front().first);
+}
+
+/* Selects XI_Enter, and XI_Motion if asked, on the window. False when the
+ * server lacks XInput 2 and the core event masks must be used instead. */
+bool selectXIPointerEvents([[maybe_unused]] Window window,
+                           [[maybe_unused]] bool withMotion) {
+#ifdef XINPUT2
+    if (xiOpcode < 0)
+        return false;
+    unsigned char bits[XIMaskLen(XI_LASTEVENT)]{};
+    XISetMask(bits, XI_Enter);
+    if (withMotion)
+        XISetMask(bits, XI_Motion);
+    XIEventMask mask{XIAllMasterDevices, sizeof bits, bits};
+    XISelectEvents(dpy, window, &mask, 1);
+    return true;
+#else
+    return false;
+#endif /* XINPUT2 */
+}
+
+void invalidateMonitorIndex() {
+    isMonitorIndexStale = true;
+    lastPointMonitor = nullptr;
+}
+
+/* Same as recttomon for a single pixel, but without visiting every monitor */
+Monitor* pointtomon(int x, int y) {
+    if (lastPointMonitor && lastPointMonitor->wRect.contains(x, y))
+        return lastPointMonitor;
+
+    if (isMonitorIndexStale) {
+        std::vector<Rect> areas;
+        for (const auto& monitor : allMonitors)
+            areas.push_back(monitor->wRect);
+        monitorIndex.rebuild(areas);
+        isMonitorIndexStale = false;
+    }
+    if (int i = monitorIndex.find(x, y); i >= 0)
+        return lastPointMonitor = allMonitors[i].get();
+    return selmon;
+}
+
 Monitor* recttomon(const Rect& rect) {
     Monitor* r = selmon;
     int area = 0;
@@ -452,9 +708,8 @@ Client* wintoclient(Window window) {
 }
 
 Monitor* wintomon(Window w) {
-    int x, y;
-    if (w == root && getrootptr(&x, &y))
-        return recttomon({x, y, 1, 1});
+    if (w == root)
+        return pointtomon(pointerX, pointerY);
 
     for (const auto& monitor : allMonitors) {
         if (w == monitor->fBarID)
@@ -496,9 +751,94 @@ bool isUniqueGeometry(XineramaScreenInfo* unique, size_t n,
 }
 #endif /* XINERAMA */
 
-int updateDisplayGeometry() {
+/* Records are only formatted while someone is subscribed */
+void publishEvent(const char* fmt, ...) {
+    if (!eventStream || !eventStream->hasSubscribers())
+        return;
+
+    char record[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(record, sizeof(record), fmt, ap);
+    va_end(ap);
+    eventStream->publish(record);
+}
+
+#ifdef XRANDR
+/* Monitors follow RandR monitors by name, so an output keeps its clients,
+ * tags and layout while others are plugged in or removed around it */
+std::vector<Monitor*> updateRandrMonitors() {
+    int count;
+    XRRMonitorInfo* info = XRRGetMonitors(dpy, root, True, &count);
+    std::vector<Monitor*> present, changed;
+
+    for (int i = 0; i < count; i++) {
+        const Rect area{info[i].x, info[i].y, info[i].width, info[i].height};
+        if (std::ranges::any_of(present, [&](Monitor* m) {
+                return m->sRect == area;
+            }))
+            continue; /* a clone of an output we already have */
+
+        auto existing = std::ranges::find_if(allMonitors, [&](auto& m) {
+            return m->fOutputName == info[i].name;
+        });
+        Monitor* monitor;
+        if (existing != allMonitors.end()) {
+            monitor = existing->get();
+        } else {
+            monitor = allMonitors
+                          .emplace_back(std::make_unique<Monitor>(
+                              allMonitors.size()))
+                          .get();
+            monitor->fOutputName = info[i].name;
+        }
+        if (monitor->sRect != area) {
+            monitor->sRect = monitor->wRect = area;
+            monitor->updateBarPosition();
+            changed.push_back(monitor);
+        }
+        present.push_back(monitor);
+    }
+    XRRFreeMonitors(info);
+    if (present.empty()) { /* every output is off, keep the old layout */
+        if (allMonitors.empty()) {
+            auto& monitor = *allMonitors.emplace_back(
+                std::make_unique<Monitor>(0));
+            monitor.sRect = monitor.wRect = {0, 0, screenWidth, screenHeight};
+            monitor.updateBarPosition();
+            changed.push_back(&monitor);
+        }
+        return changed;
+    }
+
+    Monitor* fallback = present.front();
+    std::erase_if(allMonitors, [&](auto& m) {
+        if (std::ranges::find(present, m.get()) != present.end())
+            return false;
+        m->transferAllClients(*fallback);
+        if (selmon == m.get())
+            selmon = fallback;
+        if (std::ranges::find(changed, fallback) == changed.end())
+            changed.push_back(fallback);
+        return true;
+    });
+    for (size_t i = 0; i < allMonitors.size(); i++)
+        allMonitors[i]->setMonitorNumber(i);
+    return changed;
+}
+#endif /* XRANDR */
+
+/* Returns the monitors that need their clients arranged again */
+std::vector<Monitor*> updateDisplayGeometry() {
+    std::vector<Monitor*> changed;
     bool dirty = false;
 
+#ifdef XRANDR
+    if (randrEventBase >= 0) {
+        changed = updateRandrMonitors();
+        dirty = !changed.empty();
+    } else
+#endif /* XRANDR */
 #ifdef XINERAMA
     if (XineramaIsActive(dpy)) {
         int i, j, xMonitorCount;
@@ -543,6 +883,10 @@ int updateDisplayGeometry() {
             }
         }
         delete[] unique;
+        if (dirty) {
+            for (const auto& monitor : allMonitors)
+                changed.push_back(monitor.get());
+        }
     } else
 #endif /* XINERAMA */
     {  /* default monitor setup */
@@ -556,13 +900,23 @@ int updateDisplayGeometry() {
             monitor.sRect.width = monitor.wRect.width = screenWidth;
             monitor.sRect.height = monitor.wRect.height = screenHeight;
             monitor.updateBarPosition();
+            changed.push_back(&monitor);
         }
     }
     if (dirty) {
         selmon = allMonitors.front().get();
+        getrootptr(&pointerX, &pointerY); /* outputs may have moved it */
         selmon = wintomon(root);
+
+        publishEvent("monitors %zu", allMonitors.size());
+        for (const auto& monitor : allMonitors) {
+            const auto& area = monitor->sRect;
+            publishEvent("monitor %d %d %d %d %d",
+                         monitor->getMonitorNumber(), area.x, area.y,
+                         area.width, area.height);
+        }
     }
-    return dirty;
+    return changed;
 }
 
 void updateBarsXWindows() {
@@ -595,14 +949,15 @@ void unfocus(Client* c, bool setfocus) {
     if (!c)
         return;
     c->grabXButtons(false);
-    XSetWindowBorder(dpy, c->fWindow, scheme->normal.border.pixel);
+    XSetWindowBorder(dpy, c->fWindow, scheme->normal.border->pixel);
     if (setfocus) {
         XSetInputFocus(dpy, root, RevertToPointerRoot, CurrentTime);
         netatom->activeWindow.erase();
     }
 }
 
-void manageClient(Window window, XWindowAttributes* wa) {
+void manageClient(Window window, XWindowAttributes* wa,
+                  bool shouldFocus = true) {
     auto client = std::make_unique<Client>(
         window, Rect{wa->x, wa->y, wa->width, wa->height}, wa->border_width);
 
@@ -613,11 +968,15 @@ void manageClient(Window window, XWindowAttributes* wa) {
     clientPtr->fMonitor->fSelected = clientPtr;
     clientPtr->fMonitor->arrangeClients();
     XMapWindow(dpy, clientPtr->fWindow);
-    selmon->focus();
+    publishEvent("manage 0x%lx %d", clientPtr->fWindow,
+                 clientPtr->fMonitor->getMonitorNumber());
+    if (shouldFocus)
+        selmon->focus();
 }
 
-void arrangeAllMonitors() {
-    for (const auto& monitor : allMonitors) {
+/* Only the monitors whose clients or geometry changed need a new layout */
+void arrangeMonitors(const std::vector<Monitor*>& affected) {
+    for (auto* monitor : affected) {
         monitor->hideClientsIfInvisible();
         monitor->arrangeClients(false);
     }
@@ -627,21 +986,148 @@ void sendClientToMonitor(Client* client, Monitor* monitor) {
     if (client->fMonitor == monitor)
         return;
     unfocus(client, true);
-    Client* clientPtr = monitor->attach(client->fMonitor->detach(client));
+    Monitor* source = client->fMonitor;
+    Client* clientPtr = monitor->attach(source->detach(client));
     clientPtr->fTags = monitor->getActiveTags();
     selmon->focus();
-    arrangeAllMonitors();
+    arrangeMonitors({source, monitor});
+}
+
+/* A selected urgent tag is drawn with the urgent scheme inverted */
+bool isTagInverted(const bool isSelected, const bool isUrgent) {
+    return isSelected && isUrgent;
+}
+
+const XColorScheme& getTagScheme(const size_t tag, const bool isSelected,
+                                 const bool isUrgent) {
+    if (isUrgent)
+        return scheme->urgent;
+    if (!isSelected)
+        return scheme->normal;
+    if (tag < scheme->tags.size() && scheme->tags[tag])
+        return *scheme->tags[tag];
+    return scheme->selected;
 }
 
-void drawbars() {
+void clearTagLabels() {
+    for (const auto& label : tagLabels) {
+        for (const auto& variant : label.variants) {
+            if (variant)
+                drw->releaseSurface(*variant);
+        }
+    }
+    tagLabels.clear();
+}
+
+/* Must be rerun whenever the fonts or color schemes change */
+void renderTagLabels() {
+    clearTagLabels();
+    tagLabels.reserve(tags.size()); /* drw keeps a pointer to the surface */
+    for (size_t i = 0; i < tags.size(); i++) {
+        auto& label = tagLabels.emplace_back(
+            TagLabel{.width = drw->getTextWidth(tags[i]) + lrpad});
+
+        for (int variant = 0; variant < TagLabel::VariantLast; variant++) {
+            drw->setSurface(label.variants[variant].emplace(
+                drw->createSurface(label.width, barHeight, false)));
+            const bool isSelected = variant & TagLabel::Selected;
+            const bool isUrgent = variant & TagLabel::Urgent;
+            drw->setScheme(getTagScheme(i, isSelected, isUrgent));
+            drw->renderText(0, 0, label.width, barHeight, lrpad / 2, tags[i],
+                            isTagInverted(isSelected, isUrgent));
+        }
+    }
     for (const auto& monitor : allMonitors)
-        monitor->drawbar();
+        monitor->invalidateBar();
+}
+
+void clearStatusBlocks() {
+    for (const auto& block : statusBlocks) {
+        if (block.label)
+            drw->releaseSurface(*block.label);
+    }
+    statusBlocks.clear();
+}
+
+/* The root window name comes first, followed by the blocks from the config */
+void createStatusBlocks() {
+    clearStatusBlocks();
+    statusBlocks.reserve(statusblocks.size() + 1); /* drw keeps pointers */
+    statusBlocks.push_back({.name = "", .scheme = scheme->normal});
+    for (const auto& block : statusblocks) {
+        statusBlocks.push_back({
+            .name = block.name,
+            .scheme = block.colors ? drw->parseScheme(*block.colors)
+                                   : scheme->normal,
+        });
+    }
+}
+
+bool setStatusBlockText(StatusBlock& block, const std::string_view text) {
+    if (text == block.text)
+        return false; /* nothing to redraw */
+
+    block.text = text;
+    if (text.empty()) {
+        block.width = 0;
+        if (block.label)
+            drw->releaseSurface(*block.label);
+        block.label.reset();
+        return true;
+    }
+
+    block.width = drw->getTextWidth(text) + lrpad;
+    if (!block.label ||
+        block.label->getWidth() != static_cast<uint>(block.width)) {
+        if (block.label)
+            drw->releaseSurface(*block.label);
+        block.label.emplace(drw->createSurface(block.width, barHeight, false));
+    }
+    drw->setSurface(*block.label);
+    drw->setScheme(block.scheme);
+    drw->renderText(0, 0, block.width, barHeight, lrpad / 2, text, false);
+    return true;
+}
+
+int getStatusWidth() {
+    int width = 0;
+    for (const auto& block : statusBlocks)
+        width += block.width;
+    return width;
+}
+
+/* "@name text" updates a named block, anything else the root name's block */
+bool updateStatusBlock(std::string_view line) {
+    auto* block = &statusBlocks.front();
+    if (line.starts_with('@')) {
+        const auto name = line.substr(1, line.find(' ') - 1);
+        auto named = std::ranges::find(statusBlocks, name, &StatusBlock::name);
+        if (name.empty() || named == statusBlocks.end())
+            return false;
+        block = &*named;
+        line.remove_prefix(std::min(line.size(), name.size() + 2));
+    }
+    return setStatusBlockText(*block, line);
 }
 
 void updateStatusBarMessage() {
-    if (!getXTextProperties(root, XA_WM_NAME, stext, sizeof(stext)))
-        strcpy(stext, "dwm++-" VERSION);
-    selmon->drawbar();
+    char text[256];
+    if (!getXTextProperties(root, XA_WM_NAME, text, sizeof(text)))
+        strcpy(text, statusblocks.empty() ? "dwm++-" VERSION : "");
+    if (setStatusBlockText(statusBlocks.front(), text))
+        selmon->requestBarRedraw();
+}
+
+void receiveStatusText() {
+    /* every queued update is applied before the bar is redrawn */
+    bool changed = false;
+    while (auto datagram = statusSocket->receive()) {
+        forEachLine(*datagram, [&](const std::string_view line) {
+            changed |= updateStatusBlock(line);
+        });
+    }
+    if (changed)
+        selmon->requestBarRedraw();
 }
 
 void updateAllXClientLists() {
@@ -685,13 +1171,16 @@ Client::Client(Window win, const Rect& clientRect, int borderWidth)
     XWindowChanges wc{};
     wc.border_width = fBorderWidth;
     XConfigureWindow(dpy, win, CWBorderWidth, &wc);
-    XSetWindowBorder(dpy, win, scheme->normal.border.pixel);
+    XSetWindowBorder(dpy, win, scheme->normal.border->pixel);
     sendXWindowConfiguration();
     updateWindowTypeFromX();
     updateSizeHintsFromX();
     updateWMHintsTypeFromX();
+    const long enterMask = selectXIPointerEvents(win, false)
+                               ? NoEventMask
+                               : EnterWindowMask;
     XSelectInput(dpy, win,
-                 EnterWindowMask | FocusChangeMask | PropertyChangeMask |
+                 enterMask | FocusChangeMask | PropertyChangeMask |
                      StructureNotifyMask);
     grabXButtons(false);
     if (!fFlags.isFloating) {
@@ -864,12 +1353,11 @@ void Client::resizeWithMouse() {
         }
     } while (event.type != ButtonRelease);
 
+    const unsigned long firstSerial = NextRequest(dpy);
     XWarpPointer(dpy, None, fWindow, 0, 0, 0, 0, fSize.width + fBorderWidth - 1,
                  fSize.height + fBorderWidth - 1);
     XUngrabPointer(dpy, CurrentTime);
-
-    while (XCheckMaskEvent(dpy, EnterWindowMask, &event)) {
-    }
+    ignoreEnterEventsSince(firstSerial);
 
     if (Monitor* monitor = recttomon(fSize); monitor != selmon) {
         sendClientToMonitor(this, monitor);
@@ -965,6 +1453,7 @@ void Client::setState(long state) const {
 
 void Client::setUrgent(bool urgent) {
     fFlags.isUrgent = urgent;
+    fMonitor->requestBarRedraw();
 
     if (auto wmHint = XGetWMHints(dpy, fWindow); wmHint) {
         wmHint->flags = urgent ? (wmHint->flags | XUrgencyHint)
@@ -1031,7 +1520,7 @@ void Client::updatePropertyFromEvent(Atom property) {
         break;
     case XA_WM_HINTS:
         updateWMHintsTypeFromX();
-        drawbars();
+        fMonitor->requestBarRedraw(); /* urgency only shows on its own bar */
         break;
     default:
         break;
@@ -1039,7 +1528,7 @@ void Client::updatePropertyFromEvent(Atom property) {
     if (property == XA_WM_NAME || property == netatom->wmName) {
         updateWindowTitleFromX();
         if (this == fMonitor->fSelected)
-            fMonitor->drawbar();
+            fMonitor->requestBarRedraw();
     }
     if (property == netatom->wmWindowType)
         updateWindowTypeFromX();
@@ -1055,9 +1544,7 @@ void Client::grabXButtons(bool focused) const {
         XGrabButton(dpy, AnyButton, AnyModifier, fWindow, False, BUTTONMASK,
                     GrabModeSync, GrabModeSync, None, None);
     }
-    for (const auto& button : buttons) {
-        if (button.click != ClkClientWin)
-            continue;
+    for (const auto& button : buttonTable.getRegion(ClkClientWin)) {
         for (const auto& modifier : modifiers) {
             XGrabButton(dpy, button.button, button.mask | modifier, fWindow,
                         False, BUTTONMASK, GrabModeAsync, GrabModeSync, None,
@@ -1125,6 +1612,23 @@ void Client::handleConfigurationRequest(XConfigureRequestEvent* event) {
     }
 }
 
+SnapshotClient Client::getSnapshot() const {
+    SnapshotClient snapshot{};
+    snapshot.window = fWindow;
+    snapshot.monitor = fMonitor->getMonitorNumber();
+    snapshot.tags = fTags;
+    snapshot.x = fSize.x;
+    snapshot.y = fSize.y;
+    snapshot.width = fSize.width;
+    snapshot.height = fSize.height;
+    snapshot.borderWidth = fBorderWidth;
+    snapshot.flags = (fFlags.isFloating ? SnapshotClient::Floating : 0u) |
+                     (fFlags.isFullscreen ? SnapshotClient::Fullscreen : 0u) |
+                     (fFlags.isUrgent ? SnapshotClient::Urgent : 0u) |
+                     (fFlags.isFixed ? SnapshotClient::Fixed : 0u);
+    return snapshot;
+}
+
 bool Client::sendXEvent(Atom proto) const {
     bool exists = false;
 
@@ -1320,6 +1824,13 @@ Monitor::~Monitor() {
         XSetInputFocus(dpy, root, RevertToPointerRoot, CurrentTime);
         netatom->activeWindow.erase();
     }
+    if (fBarRedrawTimer)
+        eventLoop.cancelTimer(*fBarRedrawTimer);
+    if (fBarSurface)
+        drw->releaseSurface(*fBarSurface);
+    invalidateMonitorIndex();
+    if (highlightedMonitor == this)
+        highlightedMonitor = nullptr;
     XUnmapWindow(dpy, fBarID);
     XDestroyWindow(dpy, fBarID);
 }
@@ -1328,6 +1839,10 @@ bool Monitor::isSelectedMonitor() const { return this == selmon; };
 
 int Monitor::getMonitorNumber() const { return fMonitorNumber; };
 
+#ifdef XRANDR
+void Monitor::setMonitorNumber(int number) { fMonitorNumber = number; }
+#endif /* XRANDR */
+
 Client* Monitor::getClientFromWindowID(Window win) const {
     auto client = std::ranges::find_if(
         fClients, [=](const auto& client) { return client->fWindow == win; });
@@ -1361,7 +1876,7 @@ void Monitor::setActiveLayout(const Layout* layout) {
     if (fSelected) // TODO: why does this exists?
         arrangeClients();
     else
-        drawbar();
+        requestBarRedraw();
 }
 
 void Monitor::toggleSelectedTagSet() { fSelectedTags ^= 1; }
@@ -1380,6 +1895,8 @@ auto Monitor::findClientLocation(Client* client) {
 }
 
 void Monitor::transferAllClients(Monitor& target) {
+    for (auto& client : fClients)
+        client->fMonitor = &target;
     target.fStack.insert(target.fStack.end(), fStack.begin(), fStack.end());
     target.fClients.insert(target.fClients.end(),
                            std::make_move_iterator(fClients.begin()),
@@ -1413,6 +1930,7 @@ std::unique_ptr<Client> Monitor::detach(Client* client) {
 }
 
 void Monitor::unmanage(Client* ptr, bool xResourceDestroyed) {
+    publishEvent("unmanage 0x%lx", ptr->fWindow);
     {
         auto client = detach(ptr);
         if (!xResourceDestroyed)
@@ -1452,14 +1970,27 @@ void Monitor::focus(Client* client) {
 
         shuffleToFront(fStack, std::ranges::find(fStack, client));
         client->grabXButtons(true);
-        XSetWindowBorder(dpy, client->fWindow, scheme->selected.border.pixel);
+        XSetWindowBorder(dpy, client->fWindow, scheme->selected.border->pixel);
         client->setFocus();
     } else {
         XSetInputFocus(dpy, root, RevertToPointerRoot, CurrentTime);
         netatom->activeWindow.erase();
     }
     fSelected = client;
-    drawbars();
+
+    /* only the bars that gain or lose the selection change */
+    if (highlightedMonitor != this) {
+        if (highlightedMonitor)
+            highlightedMonitor->requestBarRedraw();
+        highlightedMonitor = this;
+    }
+    requestBarRedraw();
+
+    if (std::pair focused{fMonitorNumber, client ? client->fWindow : 0};
+        focused != publishedFocus) {
+        publishedFocus = focused;
+        publishEvent("focus %d 0x%lx", focused.first, focused.second);
+    }
 }
 
 void Monitor::shiftFocusThroughStack(int direction) {
@@ -1519,10 +2050,12 @@ void Monitor::zoomClientToMaster(Client* client) {
     arrangeClients();
 }
 
-void Monitor::restackClients() const {
-    drawbar();
+void Monitor::restackClients(std::optional<unsigned long> firstSerial) const {
+    requestBarRedraw();
     if (!fSelected)
         return;
+    if (!firstSerial)
+        firstSerial = NextRequest(dpy);
     if (fSelected->getFlags().isFloating || !getActiveLayout()->arrange)
         XRaiseWindow(dpy, fSelected->fWindow);
     if (getActiveLayout()->arrange) {
@@ -1538,13 +2071,13 @@ void Monitor::restackClients() const {
             windowChanges.sibling = client->fWindow;
         }
     }
-    XEvent event{};
-    XSync(dpy, False);
-    while (XCheckMaskEvent(dpy, EnterWindowMask, &event)) {
-    }
+    ignoreEnterEventsSince(*firstSerial);
 }
 
 void Monitor::arrangeClients(bool shouldRestack) {
+    if (ArrangeBatch::defer(this, shouldRestack))
+        return;
+    const unsigned long firstSerial = NextRequest(dpy);
     hideClientsIfInvisible();
 
     strncpy(fLayoutSymbol, getActiveLayout()->symbol, sizeof(fLayoutSymbol));
@@ -1552,10 +2085,36 @@ void Monitor::arrangeClients(bool shouldRestack) {
         getActiveLayout()->arrange(this);
 
     if (shouldRestack)
-        restackClients();
+        restackClients(firstSerial); /* the moves cause crossings too */
+}
+
+ArrangeBatch::ArrangeBatch() { sDepth++; }
+
+ArrangeBatch::~ArrangeBatch() {
+    if (--sDepth > 0)
+        return;
+
+    const auto pending = std::move(sPending);
+    sPending.clear();
+    for (const auto& [monitor, shouldRestack] : pending)
+        monitor->arrangeClients(shouldRestack);
+}
+
+bool ArrangeBatch::defer(Monitor* monitor, const bool shouldRestack) {
+    if (sDepth == 0)
+        return false;
+
+    auto pending = std::ranges::find(sPending, monitor,
+                                     &PendingArrange::monitor);
+    if (pending == sPending.end())
+        sPending.push_back({monitor, shouldRestack});
+    else
+        pending->shouldRestack |= shouldRestack;
+    return true;
 }
 
 void Monitor::updateBarPosition() {
+    invalidateMonitorIndex();
     wRect.y = sRect.y;
     wRect.height = sRect.height;
     if (fShouldRenderBar) {
@@ -1567,17 +2126,65 @@ void Monitor::updateBarPosition() {
     }
 }
 
-void Monitor::drawbar() const {
-    int tw = 0;
+void renderBarSegment(const BarSegment& segment) {
     int boxs = drw->getPrimaryFontHeight() / 9;
     int boxw = drw->getPrimaryFontHeight() / 6 + 2;
+
+    drw->setScheme(*segment.scheme);
+    if (segment.label) {
+        drw->copySurface(*segment.label, segment.x, 0);
+    } else if (segment.text.empty()) {
+        drw->renderRect(segment.x, 0, segment.width, barHeight, 1,
+                        !segment.invert);
+    } else {
+        drw->renderText(segment.x, 0, segment.width, barHeight, segment.lpad,
+                        segment.text, segment.invert);
+    }
+    if (segment.indicator != BarSegment::Indicator::Hidden) {
+        drw->renderRect(segment.x + boxs, boxs, boxw, boxw,
+                        segment.indicator == BarSegment::Indicator::Filled,
+                        segment.invert);
+    }
+}
+
+/* Redraws are deferred until the pending events have been handled and limited
+ * to barfps per monitor, the latest state is drawn once the interval passes */
+void Monitor::requestBarRedraw() const {
+    if (fBarRedrawTimer)
+        return;
+
+    const auto interval =
+        EventLoop::Clock::duration{std::chrono::seconds{1}} /
+        std::max(barfps, 1u);
+    const auto elapsed = EventLoop::Clock::now() - fLastBarDraw;
+    fBarRedrawTimer = eventLoop.addTimer(
+        std::max(interval - elapsed, EventLoop::Clock::duration::zero()),
+        [this] {
+            fBarRedrawTimer.reset();
+            drawbar();
+        });
+}
+
+void Monitor::drawbar() const {
+    using enum BarSegment::Indicator;
+    int tw = 0;
     uint occ = 0, urg = 0;
+    std::vector<BarSegment> segments;
 
-    /* draw status first so it can be overdrawn by tags later */
+    /* status first so it can be overdrawn by tags later */
     if (isSelectedMonitor()) { /* status is only drawn on selected monitor */
-        drw->setScheme(scheme->normal);
-        tw = drw->getTextWidth(stext) + 2; /* 2px right padding */
-        drw->renderText(wRect.width - tw, 0, tw, barHeight, 0, stext, 0);
+        tw = getStatusWidth();
+        int blockX = wRect.width - tw;
+        for (const auto& block : statusBlocks) {
+            segments.push_back({
+                .x = blockX,
+                .width = block.width,
+                .text = block.text,
+                .scheme = &block.scheme,
+                .label = block.label ? &*block.label : nullptr,
+            });
+            blockX += block.width;
+        }
     }
 
     for (const auto& client : fClients) {
@@ -1587,40 +2194,99 @@ void Monitor::drawbar() const {
     }
     int x = 0;
     for (size_t i = 0; i < tags.size(); i++) {
-        auto w = drw->getTextWidth(tags[i]) + lrpad;
-        drw->setScheme(fTags[fSelectedTags] & 1 << i ? scheme->selected
-                                                     : scheme->normal);
-        drw->renderText(x, 0, w, barHeight, lrpad / 2, tags[i], urg & 1 << i);
-        if (occ & 1 << i) {
-            drw->renderRect(x + boxs, boxs, boxw, boxw,
-                            isSelectedMonitor() && fSelected &&
-                                fSelected->fTags & 1 << i,
-                            urg & 1 << i);
-        }
-        x += w;
+        const auto& label = tagLabels[i];
+        bool isSelected = fTags[fSelectedTags] & 1 << i;
+        bool isUrgent = urg & 1 << i;
+        bool isFilled =
+            isSelectedMonitor() && fSelected && fSelected->fTags & 1 << i;
+        segments.push_back({
+            .x = x,
+            .width = label.width,
+            .text = tags[i],
+            .scheme = &getTagScheme(i, isSelected, isUrgent),
+            .label = &*label.variants[(isSelected ? TagLabel::Selected : 0) |
+                                      (isUrgent ? TagLabel::Urgent : 0)],
+            .invert = isTagInverted(isSelected, isUrgent),
+            .indicator = occ & 1 << i ? (isFilled ? Filled : Outline) : Hidden,
+        });
+        x += label.width;
     }
     int w = blw = drw->getTextWidth(fLayoutSymbol) + lrpad;
-    drw->setScheme(scheme->normal);
-    x = drw->renderText(x, 0, w, barHeight, lrpad / 2, fLayoutSymbol, 0);
+    segments.push_back({.x = x,
+                        .width = w,
+                        .text = fLayoutSymbol,
+                        .scheme = &scheme->normal,
+                        .lpad = static_cast<uint>(lrpad / 2)});
+    x += w;
 
     if ((w = wRect.width - tw - x) > barHeight) {
         if (fSelected) {
-            drw->setScheme(isSelectedMonitor() ? scheme->selected
-                                               : scheme->normal);
-            drw->renderText(x, 0, w, barHeight, lrpad / 2, fSelected->getName(),
-                            0);
-            if (fSelected->getFlags().isFloating) {
-                drw->renderRect(x + boxs, boxs, boxw, boxw,
-                                fSelected->getFlags().isFixed, 0);
-            }
+            const auto& flags = fSelected->getFlags();
+            segments.push_back({
+                .x = x,
+                .width = w,
+                .text = std::string{fSelected->getName()},
+                .scheme =
+                    isSelectedMonitor() ? &scheme->selected : &scheme->normal,
+                .lpad = static_cast<uint>(lrpad / 2),
+                .indicator = flags.isFloating
+                                 ? (flags.isFixed ? Filled : Outline)
+                                 : Hidden,
+            });
         } else {
-            drw->setScheme(scheme->normal);
-            drw->renderRect(x, 0, w, barHeight, 1, 1);
+            segments.push_back(
+                {.x = x, .width = w, .text = "", .scheme = &scheme->normal});
         }
     }
-    drw->map(fBarID, 0, 0, wRect.width, barHeight);
+
+    if (!fBarSurface ||
+        fBarSurface->getWidth() != static_cast<uint>(wRect.width) ||
+        fBarSurface->getHeight() != static_cast<uint>(barHeight)) {
+        if (fBarSurface)
+            drw->releaseSurface(*fBarSurface);
+        fBarSurface.emplace(drw->createSurface(wRect.width, barHeight));
+        invalidateBar();
+    }
+    drw->setSurface(*fBarSurface);
+
+    /* Only segments whose content changed are rendered. A rendered segment
+     * overdraws anything beneath it, so later overlapping segments follow. */
+    std::vector<const BarSegment*> rendered;
+    DamageRegion changed;
+    for (size_t i = 0; i < segments.size(); i++) {
+        const auto& segment = segments[i];
+        if (segment.width <= 0) /* an empty status block */
+            continue;
+        if (i < fBarSegments.size() && segment == fBarSegments[i] &&
+            std::ranges::none_of(rendered, [&](const auto* other) {
+                return other->overlaps(segment);
+            })) {
+            continue;
+        }
+        renderBarSegment(segment);
+        rendered.push_back(&segment);
+        changed.add({segment.x, 0, segment.width, barHeight});
+    }
+    fBarSegments = std::move(segments);
+    drw->map(fBarID, changed.getRects());
+    fLastBarDraw = EventLoop::Clock::now();
+}
+
+void Monitor::damageBar(const Rect& area) { fBarDamage.add(area); }
+
+void Monitor::repaintBar() {
+    if (!fBarSurface || fBarSegments.empty() ||
+        fBarSurface->getWidth() != static_cast<uint>(wRect.width)) {
+        fBarDamage.clear();
+        return drawbar(); /* nothing retained, everything is redrawn */
+    }
+    drw->setSurface(*fBarSurface);
+    drw->map(fBarID, fBarDamage.getRects());
+    fBarDamage.clear();
 }
 
+void Monitor::invalidateBar() const { fBarSegments.clear(); }
+
 void Monitor::toggleBarRendering() {
     fShouldRenderBar = !fShouldRenderBar;
     updateBarPosition();
@@ -1628,6 +2294,35 @@ void Monitor::toggleBarRendering() {
     arrangeClients();
 }
 
+void Monitor::appendSnapshot(SnapshotState& state) const {
+    if (state.monitorCount == snapshotMaxMonitors)
+        return;
+
+    auto& snapshot = state.monitors[state.monitorCount++];
+    snapshot.number = fMonitorNumber;
+    snapshot.x = sRect.x;
+    snapshot.y = sRect.y;
+    snapshot.width = sRect.width;
+    snapshot.height = sRect.height;
+    snapshot.windowX = wRect.x;
+    snapshot.windowY = wRect.y;
+    snapshot.windowWidth = wRect.width;
+    snapshot.windowHeight = wRect.height;
+    snapshot.tags = getActiveTags();
+    snprintf(snapshot.layoutSymbol, sizeof(snapshot.layoutSymbol), "%s",
+             fLayoutSymbol);
+    snapshot.masterFactor = fMasterFactor;
+    snapshot.masterCount = fMasterCount;
+    snapshot.selectedWindow = fSelected ? fSelected->fWindow : 0;
+
+    for (const auto& client : fClients) {
+        if (state.clientCount == snapshotMaxClients)
+            state.omittedClients++;
+        else
+            state.clients[state.clientCount++] = client->getSnapshot();
+    }
+}
+
 void Monitor::updateXClientList() const {
     for (const auto& client : fClients)
         netatom->clientList.append(client->fWindow);
@@ -1698,6 +2393,8 @@ void focusin(XEvent* e) {
 
 void buttonpress(XEvent* e) {
     XButtonPressedEvent* ev = &e->xbutton;
+    pointerX = ev->x_root;
+    pointerY = ev->y_root;
     /* focus monitor if necessary */
     if (Monitor* m = wintomon(ev->window); m && m != selmon) {
         unfocus(selmon->fSelected, true);
@@ -1711,15 +2408,14 @@ void buttonpress(XEvent* e) {
         int x = 0;
         uint i = 0;
         do {
-            x += drw->getTextWidth(tags[i]) + lrpad;
+            x += tagLabels[i].width;
         } while (ev->x >= x && ++i < tags.size());
         if (i < tags.size()) {
             click = ClkTagBar;
             clickedTag = 1 << i;
         } else if (ev->x < x + blw) {
             click = ClkLtSymbol;
-        } else if (ev->x >
-                   selmon->wRect.width - (drw->getTextWidth(stext) + lrpad)) {
+        } else if (ev->x > selmon->wRect.width - getStatusWidth()) {
             click = ClkStatusText;
         } else {
             click = ClkWinTitle;
@@ -1730,9 +2426,8 @@ void buttonpress(XEvent* e) {
         XAllowEvents(dpy, ReplayPointer, CurrentTime);
         click = ClkClientWin;
     }
-    for (const auto& button : buttons) {
-        if (click == button.click && button.button == ev->button &&
-            CLEANMASK(button.mask) == CLEANMASK(ev->state)) {
+    for (const auto& button : buttonTable.find(click, ev->button)) {
+        if (CLEANMASK(button.mask) == CLEANMASK(ev->state)) {
             button.action(click == ClkTagBar ? clickedTag : 0u);
         }
     }
@@ -1760,22 +2455,52 @@ void clientmessage(XEvent* e) {
     }
 }
 
+void reconfigureMonitors(const std::vector<Monitor*>& changed) {
+    if (changed.empty())
+        return;
+    updateBarsXWindows();
+    for (auto* monitor : changed)
+        monitor->updateXGeometry();
+    selmon->focus();
+    arrangeMonitors(changed);
+}
+
+void updateDisplays() {
+    auto changed = updateDisplayGeometry();
+    bool dirty = screenResized;
+    screenResized = false;
+#ifdef XRANDR
+    dirty = dirty && randrEventBase < 0; /* RandR reports its own */
+#endif /* XRANDR */
+    if (dirty) {
+        changed.clear();
+        for (const auto& monitor : allMonitors)
+            changed.push_back(monitor.get());
+    }
+    reconfigureMonitors(changed);
+}
+
+/* Docking sends a burst of screen changes, the monitors are only updated once
+ * none arrived for hotplugdelay */
+void scheduleDisplayUpdate() {
+    if (displayUpdateTimer)
+        eventLoop.cancelTimer(*displayUpdateTimer);
+    displayUpdateTimer =
+        eventLoop.addTimer(std::chrono::milliseconds{hotplugdelay}, [] {
+            displayUpdateTimer.reset();
+            updateDisplays();
+        });
+}
+
 void configurenotify(XEvent* e) {
     XConfigureEvent* ev = &e->xconfigure;
 
-    /* TODO: updategeom handling sucks, needs to be simplified */
     if (ev->window == root) {
-        bool dirty = (screenWidth != ev->width || screenHeight != ev->height);
+        if (screenWidth != ev->width || screenHeight != ev->height)
+            screenResized = true;
         screenWidth = ev->width;
         screenHeight = ev->height;
-        if (updateDisplayGeometry() || dirty) {
-            drw->resize(screenWidth, barHeight);
-            updateBarsXWindows();
-            for (const auto& monitor : allMonitors)
-                monitor->updateXGeometry();
-            selmon->focus();
-            arrangeAllMonitors();
-        }
+        scheduleDisplayUpdate();
     }
 }
 
@@ -1798,21 +2523,24 @@ void configurerequest(XEvent* e) {
     XSync(dpy, False);
 }
 
+#ifdef XRANDR
+void randrnotify(XEvent* e) {
+    XRRUpdateConfiguration(e);
+    screenWidth = DisplayWidth(dpy, screen);
+    screenHeight = DisplayHeight(dpy, screen);
+    scheduleDisplayUpdate();
+}
+#endif /* XRANDR */
+
 void destroynotify(XEvent* e) {
     XDestroyWindowEvent* ev = &e->xdestroywindow;
     if (Client* client = wintoclient(ev->window); client)
         client->fMonitor->unmanage(client, true);
 }
 
-void enternotify(XEvent* e) {
-    XCrossingEvent* ev = &e->xcrossing;
-    if ((ev->mode != NotifyNormal || ev->detail == NotifyInferior) &&
-        ev->window != root) {
-        return;
-    }
-
-    Client* c = wintoclient(ev->window);
-    Monitor* m = c ? c->fMonitor : wintomon(ev->window);
+void focusEnteredWindow(Window window) {
+    Client* c = wintoclient(window);
+    Monitor* m = c ? c->fMonitor : wintomon(window);
     if (m != selmon) {
         unfocus(selmon->fSelected, true);
         selmon = m;
@@ -1822,22 +2550,53 @@ void enternotify(XEvent* e) {
     m->focus(c);
 }
 
+void enterWindow(Window window, unsigned long serial) {
+    if (isIgnoredEnterEvent(serial))
+        return; /* the window moved, not the pointer */
+
+    if (focusdelay == 0)
+        return focusEnteredWindow(window);
+
+    /* at most one focus change per focusdelay, to where the pointer is now */
+    enteredWindow = window;
+    if (!enterFocusTimer) {
+        enterFocusTimer =
+            eventLoop.addTimer(std::chrono::milliseconds{focusdelay}, [] {
+                enterFocusTimer.reset();
+                focusEnteredWindow(enteredWindow);
+            });
+    }
+}
+
+void enternotify(XEvent* e) {
+    XCrossingEvent* ev = &e->xcrossing;
+    pointerX = ev->x_root;
+    pointerY = ev->y_root;
+    if ((ev->mode != NotifyNormal || ev->detail == NotifyInferior) &&
+        ev->window != root) {
+        return;
+    }
+    enterWindow(ev->window, ev->serial);
+}
+
 void expose(XEvent* e) {
     XExposeEvent* ev = &e->xexpose;
-    if (Monitor * m; ev->count == 0 && (m = wintomon(ev->window)))
-        m->drawbar();
+    if (Monitor* m = wintomon(ev->window); m) {
+        m->damageBar({ev->x, ev->y, ev->width, ev->height});
+        if (ev->count == 0)
+            m->repaintBar();
+    }
 }
 
 void keypress(XEvent* e) {
-    XKeyEvent* ev;
-    ev = &e->xkey;
-    const auto keysym = XKeycodeToKeysym(dpy, (KeyCode)ev->keycode, 0);
-    for (const auto& key : keys) {
-        if (keysym == key.keysym &&
-            CLEANMASK(key.mod) == CLEANMASK(ev->state)) {
-            key.func();
-        }
-    }
+    XKeyEvent* ev = &e->xkey;
+    const auto it = keyBindings.find(getKeyBindingID(ev->keycode, ev->state));
+    if (it == keyBindings.end())
+        return;
+    /* copied, an action that handles events may regrab the keys */
+    const auto bindings = it->second;
+    for (const Key* key : bindings)
+        key->func();
 }
 
 void mappingnotify(XEvent* e) {
@@ -1856,13 +2615,11 @@ void maprequest(XEvent* e) {
         manageClient(ev->window, &wa);
 }
 
-void motionnotify(XEvent* e) {
+void moveRootPointer(int x, int y) {
     static Monitor* mon = nullptr;
-    XMotionEvent* ev = &e->xmotion;
-    if (ev->window != root)
-        return;
-
-    Monitor* monitor = recttomon({ev->x_root, ev->y_root, 1, 1});
+    pointerX = x;
+    pointerY = y;
+    Monitor* monitor = pointtomon(pointerX, pointerY);
     if (monitor != mon && mon) {
         unfocus(selmon->fSelected, true);
         selmon = monitor;
@@ -1871,6 +2628,34 @@ void motionnotify(XEvent* e) {
     mon = monitor;
 }
 
+void motionnotify(XEvent* e) {
+    XMotionEvent* ev = &e->xmotion;
+    if (ev->window == root)
+        moveRootPointer(ev->x_root, ev->y_root);
+}
+
+#ifdef XINPUT2
+void xinputnotify(XEvent* e) {
+    XGenericEventCookie* cookie = &e->xcookie;
+    if (cookie->extension != xiOpcode || !XGetEventData(dpy, cookie))
+        return;
+    if (cookie->evtype == XI_Enter) {
+        const auto* ev = static_cast<XIEnterEvent*>(cookie->data);
+        pointerX = static_cast<int>(ev->root_x);
+        pointerY = static_cast<int>(ev->root_y);
+        if ((ev->mode == XINotifyNormal && ev->detail != XINotifyInferior) ||
+            ev->event == root)
+            enterWindow(ev->event, ev->serial);
+    } else if (cookie->evtype == XI_Motion) {
+        const auto* ev = static_cast<XIDeviceEvent*>(cookie->data);
+        if (ev->event == root)
+            moveRootPointer(static_cast<int>(ev->root_x),
+                            static_cast<int>(ev->root_y));
+    }
+    XFreeEventData(dpy, cookie);
+}
+#endif /* XINPUT2 */
+
 void propertynotify(XEvent* e) {
     XPropertyEvent* ev = &e->xproperty;
     if ((ev->window == root) && (ev->atom == XA_WM_NAME)) {
@@ -1923,6 +2708,18 @@ void handleXEvent(XEvent* event) {
     case UnmapNotify:
         return unmapnotify(event);
     default:
+        if (RasterImage::handleCompletion(*event))
+            return;
+#ifdef XRANDR
+        if (randrEventBase >= 0 &&
+            (event->type == randrEventBase + RRScreenChangeNotify ||
+             event->type == randrEventBase + RRNotify))
+            return randrnotify(event);
+#endif /* XRANDR */
+#ifdef XINPUT2
+        if (event->type == GenericEvent)
+            return xinputnotify(event);
+#endif /* XINPUT2 */
         // TODO: throw here
         break;
     }
@@ -2038,12 +2835,18 @@ void toggletag(const uint tag) {
     }
 }
 
+void publishActiveTags() {
+    publishEvent("tags %d 0x%x", selmon->getMonitorNumber(),
+                 selmon->getActiveTags());
+}
+
 void toggleview(const uint tag) {
     uint newtagset = selmon->getActiveTags() ^ (tag & TAGMASK);
     if (newtagset) {
         selmon->setActiveTags(newtagset);
         selmon->focus();
         selmon->arrangeClients();
+        publishActiveTags();
     }
 }
 
@@ -2055,6 +2858,7 @@ void view(const uint tag) {
         selmon->setActiveTags(tag & TAGMASK);
     selmon->focus();
     selmon->arrangeClients();
+    publishActiveTags();
 }
 
 void zoom() {
@@ -2066,6 +2870,124 @@ void tile(Monitor* m) { m->tile(); }
 
 void monocle(Monitor* m) { m->monocle(); }
 
+/* Command socket */
+std::optional<int> parseInt(std::string_view text) {
+    if (text.starts_with('+'))
+        text.remove_prefix(1);
+    int value;
+    const auto [end, error] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc{} || end != text.data() + text.size())
+        return std::nullopt;
+    return value;
+}
+
+std::optional<float> parseFloat(std::string_view text) {
+    if (text.starts_with('+'))
+        text.remove_prefix(1);
+    float value;
+    const auto [end, error] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    if (error != std::errc{} || end != text.data() + text.size())
+        return std::nullopt;
+    return value;
+}
+
+/* "all" or a tag number, counting from 1 */
+std::optional<uint> parseTagMask(const std::string_view text) {
+    if (text == "all")
+        return ~0u;
+    if (const auto number = parseInt(text);
+        number && BETWEEN(*number, 1, static_cast<int>(tags.size()))) {
+        return 1u << (*number - 1);
+    }
+    return std::nullopt;
+}
+
+/* a layout symbol or a layout number, counting from 0 */
+std::optional<const Layout*> parseLayout(const std::string_view text) {
+    for (const auto& layout : layouts) {
+        if (text == layout.symbol)
+            return &layout;
+    }
+    if (const auto number = parseInt(text);
+        number && BETWEEN(*number, 0, static_cast<int>(layouts.size()) - 1)) {
+        return &layouts[*number];
+    }
+    return std::nullopt;
+}
+
+template <typename Argument>
+std::function<bool(std::string_view)>
+withArgument(std::optional<Argument> (*parse)(std::string_view),
+             void (*action)(Argument)) {
+    return [=](const std::string_view text) {
+        const auto argument = parse(text);
+        if (argument)
+            action(*argument);
+        return argument.has_value();
+    };
+}
+
+std::function<bool(std::string_view)> withoutArgument(void (*action)()) {
+    return [=](const std::string_view text) {
+        if (text.empty())
+            action();
+        return text.empty();
+    };
+}
+
+struct SocketCommand {
+    const char* name;
+    std::function<bool(std::string_view)> run; /* false for bad arguments */
+};
+
+const std::array<SocketCommand, 15> socketCommands{{
+    {"view", withArgument(parseTagMask, view)},
+    {"toggleview", withArgument(parseTagMask, toggleview)},
+    {"tag", withArgument(parseTagMask, tag)},
+    {"toggletag", withArgument(parseTagMask, toggletag)},
+    {"focusstack", withArgument<int>(parseInt, focusstack)},
+    {"focusmon", withArgument<int>(parseInt, focusmon)},
+    {"tagmon", withArgument<int>(parseInt, tagmon)},
+    {"incnmaster", withArgument<int>(parseInt, incnmaster)},
+    {"setgaps", withArgument<int>(parseInt, setgaps)},
+    {"setmfact", withArgument<float>(parseFloat, setmfact)},
+    {"setlayout", withArgument(parseLayout, setlayout)},
+    {"togglelayout", withoutArgument(togglelayout)},
+    {"togglefloating", withoutArgument(togglefloating)},
+    {"zoom", withoutArgument(zoom)},
+    {"killclient", withoutArgument(killclient)},
+}};
+
+void runCommand(const std::string_view line) {
+    const auto nameEnd = std::min(line.find(' '), line.size());
+    const auto name = line.substr(0, nameEnd);
+    const auto argument = line.substr(std::min(nameEnd + 1, line.size()));
+    if (name.empty())
+        return;
+
+    auto command =
+        std::ranges::find(socketCommands, name, &SocketCommand::name);
+    if (command == socketCommands.end()) {
+        fprintf(stderr, "dwm++: unknown command '%.*s'\n",
+                static_cast<int>(name.size()), name.data());
+    } else if (!command->run(argument)) {
+        fprintf(stderr, "dwm++: bad argument to '%s': '%.*s'\n",
+                command->name, static_cast<int>(argument.size()),
+                argument.data());
+    }
+}
+
+/* Each datagram is a batch of commands, one per line. Monitors are arranged
+ * once the whole batch ran and the bar is redrawn after that. */
+void receiveCommands() {
+    while (auto datagram = commandSocket->receive()) {
+        const ArrangeBatch batch;
+        forEachLine(*datagram, runCommand);
+    }
+}
+
 /* Setup */
 void checkotherwm() {
     xerrorxlib = XSetErrorHandler(xerrorstart);
@@ -2090,12 +3012,29 @@ void setup() {
     screenWidth = DisplayWidth(dpy, screen);
     screenHeight = DisplayHeight(dpy, screen);
     root = RootWindow(dpy, screen);
-    drw = new Drw{dpy, screen, root, static_cast<uint>(screenWidth),
-                  static_cast<uint>(screenHeight)};
+    drw = new Drw{dpy, screen, root};
     if (drw->createFontSet(fonts).empty())
         die("no fonts could be loaded.");
     lrpad = drw->getPrimaryFontHeight();
     barHeight = drw->getPrimaryFontHeight() + 2;
+#ifdef XRANDR
+    int randrBase, randrErrorBase, randrMajor, randrMinor;
+    if (XRRQueryExtension(dpy, &randrBase, &randrErrorBase) &&
+        XRRQueryVersion(dpy, &randrMajor, &randrMinor) &&
+        (randrMajor > 1 || (randrMajor == 1 && randrMinor >= 5))) {
+        randrEventBase = randrBase;
+        XRRSelectInput(dpy, root,
+                       RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask |
+                           RROutputChangeNotifyMask);
+    }
+#endif /* XRANDR */
+#ifdef XINPUT2
+    int xiEvent, xiError, xiMajor = 2, xiMinor = 0;
+    if (!XQueryExtension(dpy, "XInputExtension", &xiOpcode, &xiEvent,
+                         &xiError) ||
+        XIQueryVersion(dpy, &xiMajor, &xiMinor) != Success)
+        xiOpcode = -1;
+#endif /* XINPUT2 */
     updateDisplayGeometry();
     /* init atoms */
     XNetPropertyFactory net{dpy, root};
@@ -2122,9 +3061,28 @@ void setup() {
     });
     /* init appearance */
     scheme = drw->parseTheme(colors);
+    renderTagLabels();
+    createStatusBlocks();
     /* init bars */
     updateBarsXWindows();
     updateStatusBarMessage();
+    /* status updates without going through the root window name */
+    statusSocket =
+        DatagramSocket::create(getSocketPath(DisplayString(dpy), ".status"));
+    if (!statusSocket)
+        fputs("warning: cannot create the status socket\n", stderr);
+    commandSocket =
+        DatagramSocket::create(getSocketPath(DisplayString(dpy), ".cmd"));
+    if (!commandSocket)
+        fputs("warning: cannot create the command socket\n", stderr);
+    eventStream = EventStream::create(
+        getSocketPath(DisplayString(dpy), ".events"), eventLoop);
+    if (!eventStream)
+        fputs("warning: cannot create the event socket\n", stderr);
+    snapshotWriter =
+        SnapshotWriter::create(getSnapshotName(DisplayString(dpy)));
+    if (!snapshotWriter)
+        fputs("warning: cannot create the state snapshot\n", stderr);
     /* supporting window for NetWMCheck */
     wmcheckwin = XCreateSimpleWindow(dpy, root, 0, 0, 1, 1, 0, 0, 0);
     MutableXProperty<XA_WINDOW>{wmcheckwin, wmCheck}.overwrite({wmcheckwin});
@@ -2135,55 +3093,183 @@ void setup() {
     /* select events */
     XSetWindowAttributes wa;
     wa.cursor = cursors->normal.getXCursor();
+    const long pointerMask = selectXIPointerEvents(root, true)
+                                 ? NoEventMask
+                                 : PointerMotionMask | EnterWindowMask;
     wa.event_mask = SubstructureRedirectMask | SubstructureNotifyMask |
-                    ButtonPressMask | PointerMotionMask | EnterWindowMask |
-                    LeaveWindowMask | StructureNotifyMask | PropertyChangeMask;
+                    ButtonPressMask | pointerMask | LeaveWindowMask |
+                    StructureNotifyMask | PropertyChangeMask;
     XChangeWindowAttributes(dpy, root, CWEventMask | CWCursor, &wa);
     XSelectInput(dpy, root, wa.event_mask);
     grabkeys();
     selmon->focus();
 }
 
+/* Zeroed first: states are compared bytewise, including unused entries */
+void publishSnapshot() {
+    if (!snapshotWriter)
+        return;
+
+    SnapshotState state{};
+    state.selectedMonitor = selmon->getMonitorNumber();
+    for (const auto& monitor : allMonitors)
+        monitor->appendSnapshot(state);
+    snapshotWriter->publish(state);
+}
+
 void run() {
     XEvent ev;
     XSync(dpy, False);
     autostart();
-    while (running && !XNextEvent(dpy, &ev))
-        handleXEvent(&ev); /* TODO: Ignore unhandled events */
+
+    /* the X connection is drained below, XPending also flushes our requests
+     * before the loop goes to sleep */
+    eventLoop.watch(ConnectionNumber(dpy), [] {});
+    if (statusSocket)
+        eventLoop.watch(statusSocket->getFd(), receiveStatusText);
+    if (commandSocket)
+        eventLoop.watch(commandSocket->getFd(), receiveCommands);
+
+    while (running) {
+        for (uint handled = 1; running && XPending(dpy); handled++) {
+            XNextEvent(dpy, &ev);
+            handleXEvent(&ev); /* TODO: Ignore unhandled events */
+            /* a flood of events must not hold back bar redraws and the
+             * hotplug debounce */
+            if (handled % 64 == 0)
+                eventLoop.runExpiredTimers();
+        }
+        if (!running)
+            break;
+        publishSnapshot(); /* everything the events changed is done */
+        eventLoop.wait();
+    }
+}
+
+/* Each window is queried once, transients are managed after the windows they
+ * belong to, then the monitors are arranged and focused a single time */
+using OpenWindows = std::vector<std::pair<Window, XWindowAttributes>>;
+
+#ifdef XCB
+/* All requests go out before the first reply is awaited, so adopting n windows
+ * costs one round trip instead of 4n */
+void queryOpenWindows(const Window* wins, uint num, OpenWindows& windows,
+                      OpenWindows& transients) {
+    xcb_connection_t* conn = XGetXCBConnection(dpy);
+    struct Cookies {
+        xcb_get_window_attributes_cookie_t attributes;
+        xcb_get_geometry_cookie_t geometry;
+        xcb_get_property_cookie_t transientFor;
+        xcb_get_property_cookie_t state;
+    };
+    std::vector<Cookies> cookies;
+    cookies.reserve(num);
+    for (uint i = 0; i < num; i++) {
+        cookies.push_back({
+            xcb_get_window_attributes(conn, wins[i]),
+            xcb_get_geometry(conn, wins[i]),
+            xcb_get_property(conn, 0, wins[i], XA_WM_TRANSIENT_FOR, XA_WINDOW,
+                             0, 1),
+            xcb_get_property(conn, 0, wins[i], wmatom[WMState],
+                             wmatom[WMState], 0, 2),
+        });
+    }
+
+    for (uint i = 0; i < num; i++) {
+        auto* attributes =
+            xcb_get_window_attributes_reply(conn, cookies[i].attributes, nullptr);
+        auto* geometry =
+            xcb_get_geometry_reply(conn, cookies[i].geometry, nullptr);
+        auto* transientFor =
+            xcb_get_property_reply(conn, cookies[i].transientFor, nullptr);
+        auto* state = xcb_get_property_reply(conn, cookies[i].state, nullptr);
+
+        const bool isIconic =
+            state && state->format == 32 &&
+            xcb_get_property_value_length(state) >= 4 &&
+            *static_cast<uint32_t*>(xcb_get_property_value(state)) ==
+                IconicState;
+        if (attributes && geometry && !attributes->override_redirect &&
+            (attributes->map_state == XCB_MAP_STATE_VIEWABLE || isIconic)) {
+            XWindowAttributes wa{};
+            wa.x = geometry->x;
+            wa.y = geometry->y;
+            wa.width = geometry->width;
+            wa.height = geometry->height;
+            wa.border_width = geometry->border_width;
+            wa.map_state = attributes->map_state;
+            if (transientFor && transientFor->type == XA_WINDOW &&
+                xcb_get_property_value_length(transientFor) > 0)
+                transients.emplace_back(wins[i], wa);
+            else
+                windows.emplace_back(wins[i], wa);
+        }
+        free(attributes);
+        free(geometry);
+        free(transientFor);
+        free(state);
+    }
+}
+#else
+void queryOpenWindows(const Window* wins, uint num, OpenWindows& windows,
+                      OpenWindows& transients) {
+    for (uint i = 0; i < num; i++) {
+        Window transientFor;
+        XWindowAttributes wa;
+        if (!XGetWindowAttributes(dpy, wins[i], &wa) || wa.override_redirect)
+            continue;
+        if (wa.map_state != IsViewable &&
+            getXStateProperty(wins[i]) != IconicState)
+            continue;
+        if (XGetTransientForHint(dpy, wins[i], &transientFor))
+            transients.emplace_back(wins[i], wa);
+        else
+            windows.emplace_back(wins[i], wa);
+    }
 }
+#endif /* XCB */
 
 void scanAndManageOpenClients() {
     Window d1, d2, *wins = nullptr;
-    XWindowAttributes wa;
-    if (uint num; XQueryTree(dpy, root, &d1, &d2, &wins, &num)) {
-        for (uint i = 0; i < num; i++) {
-            if (!XGetWindowAttributes(dpy, wins[i], &wa) ||
-                wa.override_redirect || XGetTransientForHint(dpy, wins[i], &d1))
-                continue;
-            if (wa.map_state == IsViewable ||
-                getXStateProperty(wins[i]) == IconicState)
-                manageClient(wins[i], &wa);
-        }
-        for (uint i = 0; i < num; i++) { /* now the transients */
-            if (!XGetWindowAttributes(dpy, wins[i], &wa))
-                continue;
-            if (XGetTransientForHint(dpy, wins[i], &d1) &&
-                (wa.map_state == IsViewable ||
-                 getXStateProperty(wins[i]) == IconicState)) {
-                manageClient(wins[i], &wa);
-            }
-        }
-        if (wins)
-            XFree(wins);
+    uint num;
+    if (!XQueryTree(dpy, root, &d1, &d2, &wins, &num))
+        return;
+
+    OpenWindows windows, transients;
+    queryOpenWindows(wins, num, windows, transients);
+    if (wins)
+        XFree(wins);
+
+    {
+        const ArrangeBatch batch;
+        for (auto& [window, wa] : windows)
+            manageClient(window, &wa, false);
+        for (auto& [window, wa] : transients)
+            manageClient(window, &wa, false);
     }
+    selmon->focus();
 }
 
 void cleanup() {
     view(~0u);
     XUngrabKey(dpy, AnyKey, AnyModifier, root);
+    if (displayUpdateTimer)
+        eventLoop.cancelTimer(*displayUpdateTimer);
+    if (enterFocusTimer)
+        eventLoop.cancelTimer(*enterFocusTimer);
     allMonitors.clear();
     XDestroyWindow(dpy, wmcheckwin);
     cursors.reset();
+    if (statusSocket)
+        eventLoop.unwatch(statusSocket->getFd());
+    statusSocket.reset();
+    if (commandSocket)
+        eventLoop.unwatch(commandSocket->getFd());
+    commandSocket.reset();
+    eventStream.reset();
+    snapshotWriter.reset();
+    clearTagLabels(); /* surfaces must go before drw and the display */
+    clearStatusBlocks();
     delete drw; // TODO: this should be a unique pointer
     XSync(dpy, False);
     XSetInputFocus(dpy, PointerRoot, RevertToPointerRoot, CurrentTime);
@@ -0,0 +1,272 @@
+/* See LICENSE file for copyright and license details. */
+#include "ipc.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace {
+
+/* large enough for any status line or batch of commands */
+const size_t maxDatagramSize = 4096;
+/* what a subscriber may fall behind before records are dropped */
+const size_t subscriberQueueSize = 64 * 1024;
+
+std::optional<int> bindUnixSocket(const std::string& path, const int type) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path))
+        return std::nullopt;
+    strcpy(address.sun_path, path.data());
+
+    const int fd = socket(AF_UNIX, type | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return std::nullopt;
+
+    /* Only one window manager runs per display, anything left at the path is
+     * from a previous instance that didn't exit cleanly */
+    unlink(path.data());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        chmod(path.data(), S_IRUSR | S_IWUSR) < 0) {
+        close(fd);
+        return std::nullopt;
+    }
+    return fd;
+}
+
+} // namespace
+
+std::unique_ptr<DatagramSocket>
+DatagramSocket::create(const std::string& path) {
+    const auto fd = bindUnixSocket(path, SOCK_DGRAM);
+    if (!fd)
+        return nullptr;
+    return std::unique_ptr<DatagramSocket>{new DatagramSocket{*fd, path}};
+}
+
+DatagramSocket::DatagramSocket(const int fd, std::string path)
+    : fFd{fd}, fPath{std::move(path)} {}
+
+DatagramSocket::~DatagramSocket() {
+    close(fFd);
+    unlink(fPath.data());
+}
+
+int DatagramSocket::getFd() const { return fFd; }
+
+std::optional<std::string> DatagramSocket::receive() {
+    std::array<char, maxDatagramSize> buffer;
+    const auto size = recv(fFd, buffer.data(), buffer.size(), 0);
+    if (size < 0)
+        return std::nullopt;
+    return std::string{buffer.data(), static_cast<size_t>(size)};
+}
+
+RingBuffer::RingBuffer(const size_t capacity) : fData(capacity) {}
+
+bool RingBuffer::empty() const { return fSize == 0; }
+
+bool RingBuffer::push(const std::string_view bytes) {
+    if (fData.size() - fSize < bytes.size())
+        return false;
+
+    const size_t tail = (fHead + fSize) % fData.size();
+    const size_t first = std::min(bytes.size(), fData.size() - tail);
+    std::copy_n(bytes.data(), first, fData.data() + tail);
+    std::copy_n(bytes.data() + first, bytes.size() - first, fData.data());
+    fSize += bytes.size();
+    return true;
+}
+
+bool RingBuffer::writeTo(const int fd) {
+    while (fSize > 0) {
+        const size_t contiguous = std::min(fSize, fData.size() - fHead);
+        const auto written = send(fd, fData.data() + fHead, contiguous,
+                                  MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (written < 0)
+            return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+        fHead = (fHead + written) % fData.size();
+        fSize -= written;
+    }
+    fHead = 0;
+    return true;
+}
+
+std::unique_ptr<EventStream> EventStream::create(const std::string& path,
+                                                 EventLoop& loop) {
+    const auto fd = bindUnixSocket(path, SOCK_STREAM);
+    if (!fd)
+        return nullptr;
+    if (listen(*fd, SOMAXCONN) < 0) {
+        close(*fd);
+        unlink(path.data());
+        return nullptr;
+    }
+    return std::unique_ptr<EventStream>{new EventStream{*fd, path, loop}};
+}
+
+EventStream::EventStream(const int fd, std::string path, EventLoop& loop)
+    : fFd{fd}, fPath{std::move(path)}, fLoop{loop} {
+    fLoop.watch(fFd, [this] { acceptSubscribers(); });
+}
+
+EventStream::~EventStream() {
+    for (const auto& subscriber : fSubscribers) {
+        fLoop.unwatch(subscriber->fd);
+        close(subscriber->fd);
+    }
+    fLoop.unwatch(fFd);
+    close(fFd);
+    unlink(fPath.data());
+}
+
+bool EventStream::hasSubscribers() const { return !fSubscribers.empty(); }
+
+void EventStream::publish(const std::string_view record) {
+    /* copied, flush may disconnect subscribers */
+    std::vector<int> fds;
+    for (const auto& subscriber : fSubscribers) {
+        enqueue(*subscriber, record);
+        fds.push_back(subscriber->fd);
+    }
+    for (const int fd : fds)
+        flush(fd);
+}
+
+void EventStream::acceptSubscribers() {
+    int fd;
+    while ((fd = accept4(fFd, nullptr, nullptr,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        const auto& subscriber = fSubscribers.emplace_back(
+            new Subscriber{fd, RingBuffer{subscriberQueueSize}});
+        watchSubscriber(*subscriber);
+    }
+}
+
+void EventStream::enqueue(Subscriber& subscriber,
+                          const std::string_view record) {
+    /* the notice is only queued together with the record that follows it */
+    std::string lines;
+    if (subscriber.dropped > 0) {
+        char dropped[32];
+        snprintf(dropped, sizeof(dropped), "dropped %lu\n",
+                 subscriber.dropped);
+        lines = dropped;
+    }
+    lines.append(record);
+    lines.push_back('\n');
+
+    if (subscriber.queue.push(lines))
+        subscriber.dropped = 0;
+    else
+        subscriber.dropped++;
+}
+
+void EventStream::flush(const int fd) {
+    auto subscriber =
+        std::ranges::find_if(fSubscribers, [&](const auto& subscriber) {
+            return subscriber->fd == fd;
+        });
+    if (subscriber == fSubscribers.end())
+        return;
+
+    if (!(*subscriber)->queue.writeTo(fd))
+        disconnect(fd);
+    else
+        watchSubscriber(**subscriber);
+}
+
+void EventStream::disconnect(const int fd) {
+    fLoop.unwatch(fd);
+    close(fd);
+    std::erase_if(fSubscribers,
+                  [&](const auto& subscriber) { return subscriber->fd == fd; });
+}
+
+/* Subscribers only ever send to hang up, poll for writing only while there
+ * is something queued */
+void EventStream::watchSubscriber(const Subscriber& subscriber) {
+    const int fd = subscriber.fd;
+    const auto onReadable = [this, fd] {
+        char ignored[256];
+        const auto size = recv(fd, ignored, sizeof(ignored), MSG_DONTWAIT);
+        if (size == 0 || (size < 0 && errno != EAGAIN && errno != EINTR))
+            disconnect(fd);
+    };
+    if (subscriber.queue.empty())
+        fLoop.watch(fd, onReadable);
+    else
+        fLoop.watch(fd, onReadable, [this, fd] { flush(fd); });
+}
+
+std::unique_ptr<SnapshotWriter>
+SnapshotWriter::create(const std::string& name) {
+    const int fd = shm_open(name.data(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+                            S_IRUSR | S_IWUSR);
+    if (fd < 0)
+        return nullptr;
+
+    void* memory = MAP_FAILED;
+    if (ftruncate(fd, sizeof(Snapshot)) == 0) {
+        memory = mmap(nullptr, sizeof(Snapshot), PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+    }
+    close(fd); /* the mapping keeps the region alive */
+    if (memory == MAP_FAILED) {
+        shm_unlink(name.data());
+        return nullptr;
+    }
+
+    /* fresh pages are zero: sequence 0 with no monitors and no clients */
+    auto* snapshot = new (memory) Snapshot{};
+    snapshot->magic = snapshotMagic;
+    snapshot->version = snapshotVersion;
+    return std::unique_ptr<SnapshotWriter>{new SnapshotWriter{name, snapshot}};
+}
+
+SnapshotWriter::SnapshotWriter(std::string name, Snapshot* snapshot)
+    : fName{std::move(name)}, fSnapshot{snapshot} {}
+
+SnapshotWriter::~SnapshotWriter() {
+    munmap(fSnapshot, sizeof(Snapshot));
+    shm_unlink(fName.data());
+}
+
+void SnapshotWriter::publish(const SnapshotState& state) {
+    /* we are the only writer, our own copy is never torn */
+    if (std::memcmp(&fSnapshot->state, &state, sizeof(state)) == 0)
+        return;
+
+    const auto sequence = fSnapshot->sequence.load(std::memory_order_relaxed);
+    fSnapshot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&fSnapshot->state, &state, sizeof(state));
+    fSnapshot->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+std::string getSocketPath(const char* displayName, const char* suffix) {
+    const char* directory = getenv("XDG_RUNTIME_DIR");
+    if (!directory || !*directory)
+        directory = "/tmp";
+    return std::string{directory} + "/dwm++" + displayName + suffix;
+}
+
+std::string getSnapshotName(const char* displayName) {
+    std::string name = std::string{"/dwm++"} + displayName;
+    std::replace(name.begin() + 1, name.end(), '/', '_');
+    return name;
+}
@@ -0,0 +1,103 @@
+/* See LICENSE file for copyright and license details. */
+#pragma once
+
+#include "loop.hpp"
+#include "snapshot.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/* A non-blocking Unix datagram socket bound to a path, one message per
+ * datagram. The path is removed again when the socket is destroyed. */
+class DatagramSocket {
+  public:
+    static std::unique_ptr<DatagramSocket> create(const std::string& path);
+    DatagramSocket(const DatagramSocket&) = delete;
+    ~DatagramSocket();
+
+    int getFd() const;
+    std::optional<std::string> receive(); /* empty when nothing is queued */
+
+  private:
+    DatagramSocket(int fd, std::string path);
+
+    int fFd;
+    std::string fPath;
+};
+
+/* Bytes waiting to be written to a non-blocking descriptor, in a buffer that
+ * never grows */
+class RingBuffer {
+  public:
+    explicit RingBuffer(size_t capacity);
+
+    bool empty() const;
+    bool push(std::string_view); /* all or nothing, false when full */
+    bool writeTo(int fd);        /* false once the descriptor failed */
+
+  private:
+    std::vector<char> fData;
+    size_t fHead = 0;
+    size_t fSize = 0;
+};
+
+/* A Unix stream socket which sends every published record, one line each, to
+ * all connected subscribers. A subscriber that stops reading never blocks the
+ * publisher: once its queue is full further records are dropped and counted,
+ * and a "dropped <count>" record is queued as soon as there is room again. */
+class EventStream {
+  public:
+    static std::unique_ptr<EventStream> create(const std::string& path,
+                                               EventLoop&);
+    EventStream(const EventStream&) = delete;
+    ~EventStream();
+
+    bool hasSubscribers() const;
+    void publish(std::string_view record);
+
+  private:
+    struct Subscriber {
+        int fd;
+        RingBuffer queue;
+        unsigned long dropped = 0;
+    };
+
+    EventStream(int fd, std::string path, EventLoop&);
+
+    void acceptSubscribers();
+    void enqueue(Subscriber&, std::string_view record);
+    void flush(int fd);
+    void disconnect(int fd);
+    void watchSubscriber(const Subscriber&);
+
+    int fFd;
+    std::string fPath;
+    EventLoop& fLoop;
+    std::vector<std::unique_ptr<Subscriber>> fSubscribers;
+};
+
+/* Owns the shared memory region described in snapshot.hpp */
+class SnapshotWriter {
+  public:
+    static std::unique_ptr<SnapshotWriter> create(const std::string& name);
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    ~SnapshotWriter();
+
+    /* Readers only see a new sequence when the state actually changed */
+    void publish(const SnapshotState&);
+
+  private:
+    SnapshotWriter(std::string name, Snapshot*);
+
+    std::string fName;
+    Snapshot* fSnapshot;
+};
+
+/* Where the sockets of the window manager on this display live */
+std::string getSocketPath(const char* displayName, const char* suffix);
+/* The name of its shared memory snapshot, for shm_open */
+std::string getSnapshotName(const char* displayName);
@@ -0,0 +1,92 @@
+/* See LICENSE file for copyright and license details. */
+#include "loop.hpp"
+#include "util.hpp"
+
+#include <poll.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <utility>
+#include <vector>
+
+void EventLoop::watch(const int fd, Callback onReadable,
+                      Callback onWritable) {
+    unwatch(fd);
+    fWatches.push_back({fd, std::move(onReadable), std::move(onWritable)});
+}
+
+void EventLoop::unwatch(const int fd) {
+    std::erase_if(fWatches, [&](const auto& watch) { return watch.fd == fd; });
+}
+
+EventLoop::TimerID EventLoop::addTimer(const Clock::duration delay,
+                                       Callback onExpired) {
+    fTimers.emplace(std::pair{Clock::now() + delay, ++fLastTimerID},
+                    std::move(onExpired));
+    return fLastTimerID;
+}
+
+void EventLoop::cancelTimer(const TimerID id) {
+    std::erase_if(fTimers,
+                  [&](const auto& timer) { return timer.first.second == id; });
+}
+
+void EventLoop::wait() {
+    std::vector<pollfd> fds;
+    fds.reserve(fWatches.size());
+    for (const auto& watch : fWatches) {
+        const short events = POLLIN | (watch.onWritable ? POLLOUT : 0);
+        fds.push_back({.fd = watch.fd, .events = events, .revents = 0});
+    }
+
+    if (poll(fds.data(), fds.size(), getPollTimeout()) < 0) {
+        if (errno == EINTR)
+            return;
+        die("poll:");
+    }
+    runExpiredTimers();
+
+    /* callbacks may unwatch descriptors, look each one up again */
+    const auto run = [&](const int fd, Callback Watch::*callback) {
+        auto watch = std::ranges::find(fWatches, fd, &Watch::fd);
+        if (watch != fWatches.end() && (*watch).*callback) {
+            auto onReady = (*watch).*callback;
+            onReady();
+        }
+    };
+    for (const auto& fd : fds) {
+        if (fd.revents & POLLOUT)
+            run(fd.fd, &Watch::onWritable);
+        if (fd.revents & (POLLIN | POLLHUP | POLLERR))
+            run(fd.fd, &Watch::onReadable);
+    }
+}
+
+int EventLoop::getPollTimeout() const {
+    if (fTimers.empty())
+        return -1;
+
+    /* rounded up, waking early would only poll again */
+    const auto remaining = fTimers.begin()->first.first - Clock::now();
+    return std::max<long>(
+        0, std::chrono::ceil<std::chrono::milliseconds>(remaining).count());
+}
+
+void EventLoop::runExpiredTimers() {
+    /* Timers added by callbacks wait for the next round, even with no delay,
+     * so a callback that reschedules itself can't starve the loop */
+    const auto now = Clock::now();
+    const auto lastID = fLastTimerID;
+    for (auto timer = fTimers.begin();
+         timer != fTimers.end() && timer->first.first <= now;) {
+        if (timer->first.second > lastID) {
+            ++timer;
+            continue;
+        }
+        auto onExpired = std::move(timer->second);
+        fTimers.erase(timer);
+        onExpired();
+        timer = fTimers.begin(); /* callbacks may have cancelled others */
+    }
+}
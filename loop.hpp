@@ -0,0 +1,45 @@
+/* See LICENSE file for copyright and license details. */
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <utility>
+#include <vector>
+
+/* Waits on the X connection and any other file descriptors at once, then runs
+ * the callbacks of those that became ready and of expired timers */
+class EventLoop {
+  public:
+    using Callback = std::function<void()>;
+    using Clock = std::chrono::steady_clock;
+    using TimerID = unsigned long;
+
+    /* Replaces any earlier watch of fd, the descriptor is only polled for
+     * writing while onWritable is set */
+    void watch(int fd, Callback onReadable, Callback onWritable = {});
+    void unwatch(int fd);
+
+    /* One-shot, a zero delay runs the callback once the loop next waits */
+    TimerID addTimer(Clock::duration delay, Callback onExpired);
+    void cancelTimer(TimerID);
+
+    /* Blocks until at least one watched descriptor is readable, a timer
+     * expires or a signal arrives */
+    void wait();
+    /* For callers that handle a long run of events without waiting */
+    void runExpiredTimers();
+
+  private:
+    struct Watch {
+        int fd;
+        Callback onReadable;
+        Callback onWritable;
+    };
+
+    int getPollTimeout() const;
+
+    std::vector<Watch> fWatches;
+    std::map<std::pair<Clock::time_point, TimerID>, Callback> fTimers;
+    TimerID fLastTimerID = 0;
+};
@@ -0,0 +1,373 @@
+/* See LICENSE file for copyright and license details. */
+#include "raster.hpp"
+#include "util.hpp"
+
+#include <X11/Xft/Xft.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#ifdef SHMBAR
+#include <X11/extensions/XShm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif /* SHMBAR */
+
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#ifdef SHMBAR
+struct RasterImage::Segment : XShmSegmentInfo {};
+#else
+struct RasterImage::Segment {};
+#endif /* SHMBAR */
+
+namespace {
+
+uint8_t blend(const uint8_t source, const uint8_t target, const uint8_t alpha) {
+    return (source * alpha + target * (255 - alpha)) / 255;
+}
+
+uint8_t blendPremultiplied(const uint8_t source, const uint8_t target,
+                           const uint8_t alpha) {
+    return source + target * (255 - alpha) / 255;
+}
+
+#ifdef SHMBAR
+bool shmAttachFailed = false;
+int completionType = -1;
+std::map<ShmSeg, RasterImage*> sharedImages; /* by segment, for completions */
+
+int shmAttachError(Display*, XErrorEvent*) {
+    shmAttachFailed = true;
+    return 0;
+}
+#endif /* SHMBAR */
+
+} // namespace
+
+const GlyphAtlas::Glyph& GlyphAtlas::getGlyph(XftFont* font,
+                                              const FT_UInt index) {
+    const auto key = std::pair{font, index};
+    if (auto cached = fGlyphs.find(key); cached != fGlyphs.end())
+        return cached->second;
+
+    return fGlyphs.emplace(key, rasterize(font, index)).first->second;
+}
+
+const uint8_t* GlyphAtlas::getPixels(const Glyph& glyph) const {
+    return fPixels.data() + glyph.offset;
+}
+
+GlyphAtlas::Glyph GlyphAtlas::rasterize(XftFont* font, const FT_UInt index) {
+    Glyph glyph{};
+    glyph.offset = fPixels.size();
+
+    FT_Face face = XftLockFace(font);
+    if (!face)
+        return glyph;
+
+    const FT_Int32 flags =
+        FT_LOAD_RENDER | (FT_HAS_COLOR(face) ? FT_LOAD_COLOR : 0);
+    if (FT_Load_Glyph(face, index, flags) != 0) {
+        XftUnlockFace(font);
+        return glyph;
+    }
+
+    const auto* slot = face->glyph;
+    const auto& bitmap = slot->bitmap;
+    glyph.isColored = bitmap.pixel_mode == FT_PIXEL_MODE_BGRA;
+
+    /* Color bitmap fonts only come in a few fixed sizes, which are usually far
+     * larger than the bar. Scale them down to the line height. */
+    float scale = 1.0f;
+    if (const int lineHeight = font->ascent + font->descent;
+        glyph.isColored && static_cast<int>(bitmap.rows) > lineHeight) {
+        scale = static_cast<float>(lineHeight) / bitmap.rows;
+    }
+    glyph.width = bitmap.width * scale;
+    glyph.height = bitmap.rows * scale;
+    glyph.left = std::lround(slot->bitmap_left * scale);
+    glyph.top = std::lround(slot->bitmap_top * scale);
+    glyph.advance = std::lround(slot->advance.x / 64.0f * scale);
+
+    const int bytesPerPixel = glyph.isColored ? 4 : 1;
+    fPixels.resize(glyph.offset + glyph.width * glyph.height * bytesPerPixel);
+    auto* pixels = fPixels.data() + glyph.offset;
+
+    for (int y = 0; y < glyph.height; y++) {
+        const auto* row =
+            bitmap.buffer + static_cast<int>(y / scale) * bitmap.pitch;
+        for (int x = 0; x < glyph.width; x++) {
+            const int column = x / scale;
+            auto* pixel = pixels + (y * glyph.width + x) * bytesPerPixel;
+            switch (bitmap.pixel_mode) {
+            case FT_PIXEL_MODE_BGRA:
+                std::memcpy(pixel, row + column * 4, 4);
+                break;
+            case FT_PIXEL_MODE_GRAY:
+                *pixel = row[column];
+                break;
+            case FT_PIXEL_MODE_MONO:
+                *pixel = row[column / 8] & (0x80 >> (column % 8)) ? 255 : 0;
+                break;
+            default:
+                *pixel = 0;
+                break;
+            }
+        }
+    }
+    XftUnlockFace(font);
+
+    return glyph;
+}
+
+bool RasterImage::isSupported(Display* display, const int screen) {
+#ifdef SHMBAR
+    const auto* visual = DefaultVisual(display, screen);
+    if (!XShmQueryExtension(display) || visual->c_class != TrueColor ||
+        visual->red_mask != 0xff0000 || visual->green_mask != 0xff00 ||
+        visual->blue_mask != 0xff) {
+        return false;
+    }
+    completionType = XShmGetEventBase(display) + ShmCompletion;
+    /* The server must be able to attach to our memory, which it can't when
+     * it is remote. Try it once with a throwaway image. */
+    return create(display, screen, 1, 1) != nullptr;
+#else
+    (void)display;
+    (void)screen;
+    return false;
+#endif /* SHMBAR */
+}
+
+std::unique_ptr<RasterImage> RasterImage::create(Display* display,
+                                                 const int screen, const uint w,
+                                                 const uint h,
+                                                 const bool isShared) {
+#ifdef SHMBAR
+    if (!isShared) {
+        auto* image = XCreateImage(display, DefaultVisual(display, screen),
+                                   DefaultDepth(display, screen), ZPixmap, 0,
+                                   nullptr, w, h, 32, 0);
+        if (!image)
+            return nullptr;
+        if (image->bits_per_pixel != 32 ||
+            !(image->data = static_cast<char*>(
+                  calloc(image->bytes_per_line, image->height)))) {
+            XDestroyImage(image);
+            return nullptr;
+        }
+        return std::unique_ptr<RasterImage>{
+            new RasterImage{display, nullptr, image}};
+    }
+
+    auto segment = std::make_unique<Segment>();
+    auto* image = XShmCreateImage(display, DefaultVisual(display, screen),
+                                  DefaultDepth(display, screen), ZPixmap,
+                                  nullptr, segment.get(), w, h);
+    if (!image)
+        return nullptr;
+    if (image->bits_per_pixel != 32) {
+        XDestroyImage(image);
+        return nullptr;
+    }
+
+    segment->shmid = shmget(IPC_PRIVATE, image->bytes_per_line * image->height,
+                            IPC_CREAT | 0600);
+    if (segment->shmid < 0) {
+        XDestroyImage(image);
+        return nullptr;
+    }
+    segment->shmaddr = image->data =
+        static_cast<char*>(shmat(segment->shmid, nullptr, 0));
+    segment->readOnly = False;
+    if (segment->shmaddr == reinterpret_cast<char*>(-1)) {
+        shmctl(segment->shmid, IPC_RMID, nullptr);
+        XDestroyImage(image);
+        return nullptr;
+    }
+
+    shmAttachFailed = false;
+    auto* previousErrorHandler = XSetErrorHandler(shmAttachError);
+    XShmAttach(display, segment.get());
+    XSync(display, False);
+    XSetErrorHandler(previousErrorHandler);
+
+    /* the segment is released once both sides detach from it */
+    shmctl(segment->shmid, IPC_RMID, nullptr);
+    if (shmAttachFailed) {
+        shmdt(segment->shmaddr);
+        XDestroyImage(image);
+        return nullptr;
+    }
+    const auto shmseg = segment->shmseg;
+    auto* raster = new RasterImage{display, std::move(segment), image};
+    sharedImages[shmseg] = raster;
+    return std::unique_ptr<RasterImage>{raster};
+#else
+    (void)display;
+    (void)screen;
+    (void)w;
+    (void)h;
+    (void)isShared;
+    return nullptr;
+#endif /* SHMBAR */
+}
+
+RasterImage::RasterImage(Display* display, std::unique_ptr<Segment> segment,
+                         XImage* image)
+    : fDisplay{display}, fSegment{std::move(segment)}, fImage{image} {}
+
+RasterImage::~RasterImage() {
+#ifdef SHMBAR
+    if (fSegment) {
+        sharedImages.erase(fSegment->shmseg);
+        XShmDetach(fDisplay, fSegment.get());
+    }
+    XDestroyImage(fImage); /* frees the pixels unless they are shared */
+    if (fSegment)
+        shmdt(fSegment->shmaddr);
+#endif /* SHMBAR */
+}
+
+void RasterImage::fill(const Rect& area, const unsigned long pixel) {
+    waitForServer();
+
+    const auto clipped = clip(area);
+    for (int y = clipped.y; y < clipped.y + clipped.height; y++) {
+        std::fill_n(getRow(y) + clipped.x, clipped.width,
+                    static_cast<uint32_t>(pixel));
+    }
+}
+
+void RasterImage::drawGlyph(const GlyphAtlas& atlas,
+                            const GlyphAtlas::Glyph& glyph, const int x,
+                            const int y, const XRenderColor& color) {
+    waitForServer();
+
+    const int left = x + glyph.left;
+    const int top = y - glyph.top;
+    const auto clipped = clip({left, top, glyph.width, glyph.height});
+    const auto* pixels = atlas.getPixels(glyph);
+    const uint8_t red = color.red >> 8;
+    const uint8_t green = color.green >> 8;
+    const uint8_t blue = color.blue >> 8;
+
+    for (int row = clipped.y; row < clipped.y + clipped.height; row++) {
+        auto* target = getRow(row);
+        for (int column = clipped.x; column < clipped.x + clipped.width;
+             column++) {
+            const auto i = (row - top) * glyph.width + (column - left);
+            const uint32_t pixel = target[column];
+            uint8_t r = pixel >> 16, g = pixel >> 8, b = pixel;
+
+            if (glyph.isColored) {
+                const auto* bgra = pixels + i * 4;
+                r = blendPremultiplied(bgra[2], r, bgra[3]);
+                g = blendPremultiplied(bgra[1], g, bgra[3]);
+                b = blendPremultiplied(bgra[0], b, bgra[3]);
+            } else {
+                r = blend(red, r, pixels[i]);
+                g = blend(green, g, pixels[i]);
+                b = blend(blue, b, pixels[i]);
+            }
+            target[column] = (pixel & 0xff000000) | r << 16 | g << 8 | b;
+        }
+    }
+}
+
+void RasterImage::copy(const RasterImage& source, const int x, const int y) {
+    waitForServer();
+
+    const auto clipped =
+        clip({x, y, source.fImage->width, source.fImage->height});
+    for (int row = clipped.y; row < clipped.y + clipped.height; row++) {
+        const auto* sourceRow = reinterpret_cast<const uint32_t*>(
+            source.fImage->data + (row - y) * source.fImage->bytes_per_line);
+        std::copy_n(sourceRow + (clipped.x - x), clipped.width,
+                    getRow(row) + clipped.x);
+    }
+}
+
+void RasterImage::put(const Drawable target, GC gc, const Rect& area,
+                      const int x, const int y) {
+#ifdef SHMBAR
+    const auto clipped = clip(area);
+    if (!fSegment) { /* not expected to be uploaded, but still correct */
+        XPutImage(fDisplay, target, gc, fImage, clipped.x, clipped.y,
+                  x + clipped.x - area.x, y + clipped.y - area.y,
+                  clipped.width, clipped.height);
+        return;
+    }
+    XShmPutImage(fDisplay, target, gc, fImage, clipped.x, clipped.y,
+                 x + clipped.x - area.x, y + clipped.y - area.y, clipped.width,
+                 clipped.height, True);
+    fPendingPuts++;
+#else
+    (void)target;
+    (void)gc;
+    (void)area;
+    (void)x;
+    (void)y;
+#endif /* SHMBAR */
+}
+
+uint32_t* RasterImage::getRow(const int y) {
+    return reinterpret_cast<uint32_t*>(fImage->data +
+                                       y * fImage->bytes_per_line);
+}
+
+Rect RasterImage::clip(const Rect& area) const {
+    const int left = std::max(area.x, 0);
+    const int top = std::max(area.y, 0);
+    const int right = std::min(area.x + area.width, fImage->width);
+    const int bottom = std::min(area.y + area.height, fImage->height);
+    return {left, top, std::max(right - left, 0), std::max(bottom - top, 0)};
+}
+
+bool RasterImage::handleCompletion(const XEvent& event) {
+#ifdef SHMBAR
+    if (event.type != completionType)
+        return false;
+    const auto& completion =
+        reinterpret_cast<const XShmCompletionEvent&>(event);
+    if (auto image = sharedImages.find(completion.shmseg);
+        image != sharedImages.end() && image->second->fPendingPuts > 0) {
+        image->second->fPendingPuts--;
+    }
+    return true;
+#else
+    (void)event;
+    return false;
+#endif /* SHMBAR */
+}
+
+Bool RasterImage::isCompletionOf(Display*, XEvent* event, XPointer image) {
+#ifdef SHMBAR
+    const auto* raster = reinterpret_cast<const RasterImage*>(image);
+    return event->type == completionType &&
+           reinterpret_cast<const XShmCompletionEvent*>(event)->shmseg ==
+               raster->fSegment->shmseg;
+#else
+    (void)event;
+    (void)image;
+    return False;
+#endif /* SHMBAR */
+}
+
+void RasterImage::waitForServer() {
+    /* The server reads the shared memory asynchronously, it must be done with
+     * the uploads before the pixels can change. Usually the main loop already
+     * received their completion events, otherwise we block for them. */
+    while (fPendingPuts > 0) {
+        XEvent event;
+        XIfEvent(fDisplay, &event, isCompletionOf,
+                 reinterpret_cast<XPointer>(this));
+        fPendingPuts--;
+    }
+}
@@ -0,0 +1,71 @@
+/* See LICENSE file for copyright and license details. */
+#pragma once
+
+#include "util.hpp"
+
+#include <X11/Xft/Xft.h>
+#include <X11/Xlib.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/* Glyph bitmaps rasterized with FreeType, kept client-side for the lifetime of
+ * their font. Color glyphs are supported: they never reach the X server. */
+class GlyphAtlas {
+  public:
+    struct Glyph {
+        int left, top; /* bitmap origin relative to the pen and baseline */
+        int width, height;
+        int advance;
+        bool isColored; /* premultiplied BGRA instead of an alpha mask */
+        size_t offset;  /* into the atlas pixels */
+    };
+
+    const Glyph& getGlyph(XftFont*, FT_UInt);
+    const uint8_t* getPixels(const Glyph&) const;
+
+  private:
+    Glyph rasterize(XftFont*, FT_UInt);
+
+    std::map<std::pair<XftFont*, FT_UInt>, Glyph> fGlyphs;
+    std::vector<uint8_t> fPixels;
+};
+
+/* A client-side image with 32 bits per pixel which is uploaded to the X server
+ * through MIT-SHM. Images that are only copied into others stay in plain
+ * memory instead. Only available when built with SHMBAR. */
+class RasterImage {
+  public:
+    static bool isSupported(Display*, int screen);
+    static std::unique_ptr<RasterImage> create(Display*, int screen, uint w,
+                                               uint h, bool isShared = true);
+    /* Every event read from the connection must be passed here, it returns
+     * true for upload completions, which are consumed */
+    static bool handleCompletion(const XEvent&);
+    RasterImage(const RasterImage&) = delete;
+    ~RasterImage();
+
+    void fill(const Rect&, unsigned long pixel);
+    void drawGlyph(const GlyphAtlas&, const GlyphAtlas::Glyph&, int x, int y,
+                   const XRenderColor&);
+    void copy(const RasterImage& source, int x, int y);
+    void put(Drawable, GC, const Rect&, int x, int y);
+
+  private:
+    struct Segment;
+
+    RasterImage(Display*, std::unique_ptr<Segment>, XImage*);
+
+    uint32_t* getRow(int y);
+    Rect clip(const Rect&) const;
+    void waitForServer();
+    static Bool isCompletionOf(Display*, XEvent*, XPointer image);
+
+    Display* fDisplay;
+    std::unique_ptr<Segment> fSegment;
+    XImage* fImage;
+    uint fPendingPuts = 0; /* uploads the server may still read */
+};
@@ -0,0 +1,79 @@
+/* See LICENSE file for copyright and license details. */
+#pragma once
+
+/* Layout of the window manager state published in shared memory. The region
+ * is named "/dwm++<DISPLAY>" (with any '/' in the display name replaced by
+ * '_'), readers shm_open it read-only, mmap sizeof(Snapshot) bytes and copy
+ * the state out with readSnapshot. This header has no other dependencies. */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+const uint32_t snapshotMagic = 0x2b2b6d77; /* "wm++" */
+const uint32_t snapshotVersion = 1;
+const size_t snapshotMaxMonitors = 16;
+const size_t snapshotMaxClients = 256;
+
+struct SnapshotMonitor {
+    int32_t number;
+    int32_t x, y, width, height; /* of the screen */
+    int32_t windowX, windowY, windowWidth, windowHeight; /* minus the bar */
+    uint32_t tags; /* active tag mask */
+    char layoutSymbol[16];
+    float masterFactor;
+    int32_t masterCount;
+    uint64_t selectedWindow; /* 0 when nothing is focused */
+};
+
+struct SnapshotClient {
+    enum : uint32_t {
+        Floating = 1 << 0,
+        Fullscreen = 1 << 1,
+        Urgent = 1 << 2,
+        Fixed = 1 << 3,
+    };
+
+    uint64_t window;
+    int32_t monitor;
+    uint32_t tags;
+    int32_t x, y, width, height;
+    int32_t borderWidth;
+    uint32_t flags;
+};
+
+struct SnapshotState {
+    int32_t selectedMonitor;
+    uint32_t monitorCount;
+    uint32_t clientCount;
+    uint32_t omittedClients; /* beyond snapshotMaxClients */
+    SnapshotMonitor monitors[snapshotMaxMonitors];
+    SnapshotClient clients[snapshotMaxClients];
+};
+
+/* Fields are laid out without padding so equal states compare equal bytewise */
+static_assert(sizeof(SnapshotMonitor) == 72 && sizeof(SnapshotClient) == 40);
+
+/* The sequence is odd while the state is being written, a reader retries
+ * until it copied the state with the same even sequence before and after */
+struct Snapshot {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint32_t> sequence;
+    SnapshotState state;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+inline void readSnapshot(const Snapshot& snapshot, SnapshotState& state) {
+    while (true) {
+        const auto before = snapshot.sequence.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+        std::memcpy(&state, &snapshot.state, sizeof(state));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (snapshot.sequence.load(std::memory_order_relaxed) == before)
+            return;
+    }
+}
@@ -15,6 +15,98 @@ int Rect::getIntersection(const Rect& other) const {
                            std::max(y, other.y));
 }
 
+bool Rect::contains(int px, int py) const {
+    return x <= px && px < x + width && y <= py && py < y + height;
+}
+
+bool Rect::touches(const Rect& other) const {
+    return x <= other.x + other.width && other.x <= x + width &&
+           y <= other.y + other.height && other.y <= y + height;
+}
+
+Rect Rect::getBoundingBox(const Rect& other) const {
+    const int left = std::min(x, other.x);
+    const int top = std::min(y, other.y);
+    return {left, top,
+            std::max(x + width, other.x + other.width) - left,
+            std::max(y + height, other.y + other.height) - top};
+}
+
+void DamageRegion::add(Rect rect) {
+    if (rect.width <= 0 || rect.height <= 0)
+        return;
+
+    /* Growing the rectangle may make it touch one that was checked earlier */
+    for (auto it = fRects.begin(); it != fRects.end();) {
+        if (it->touches(rect)) {
+            rect = rect.getBoundingBox(*it);
+            fRects.erase(it);
+            it = fRects.begin();
+        } else {
+            ++it;
+        }
+    }
+    fRects.push_back(rect);
+}
+
+void DamageRegion::clear() { fRects.clear(); }
+
+bool DamageRegion::empty() const { return fRects.empty(); }
+
+const std::vector<Rect>& DamageRegion::getRects() const { return fRects; }
+
+namespace {
+std::vector<int> getSortedEdges(std::vector<int> edges) {
+    std::ranges::sort(edges);
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+    return edges;
+}
+
+/* The cell between edges[i] and edges[i + 1], -1 outside of them all */
+int getCell(const std::vector<int>& edges, int position) {
+    auto it = std::ranges::upper_bound(edges, position);
+    if (it == edges.begin() || it == edges.end())
+        return -1;
+    return it - edges.begin() - 1;
+}
+} // namespace
+
+void RectIndex::rebuild(const std::vector<Rect>& rects) {
+    std::vector<int> xs, ys;
+    for (const auto& rect : rects) {
+        xs.insert(xs.end(), {rect.x, rect.x + rect.width});
+        ys.insert(ys.end(), {rect.y, rect.y + rect.height});
+    }
+    fXs = getSortedEdges(std::move(xs));
+    fYs = getSortedEdges(std::move(ys));
+
+    const size_t columns = fXs.empty() ? 0 : fXs.size() - 1;
+    const size_t rows = fYs.empty() ? 0 : fYs.size() - 1;
+    fCells.assign(columns * rows, -1);
+
+    /* Every edge is a cell boundary, so cells are fully inside or outside */
+    for (int i = rects.size() - 1; i >= 0; i--) {
+        const auto& rect = rects[i];
+        if (rect.width <= 0 || rect.height <= 0)
+            continue;
+        const size_t left = std::ranges::lower_bound(fXs, rect.x) - fXs.begin();
+        const size_t top = std::ranges::lower_bound(fYs, rect.y) - fYs.begin();
+        for (size_t row = top; fYs[row] < rect.y + rect.height; row++) {
+            for (size_t column = left; fXs[column] < rect.x + rect.width;
+                 column++)
+                fCells[row * columns + column] = i;
+        }
+    }
+}
+
+int RectIndex::find(int x, int y) const {
+    const int column = getCell(fXs, x);
+    const int row = getCell(fYs, y);
+    if (column < 0 || row < 0)
+        return -1;
+    return fCells[row * (fXs.size() - 1) + column];
+}
+
 void die(const char* fmt, ...) {
     va_list ap;
 
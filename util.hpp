@@ -1,8 +1,10 @@
 /* See LICENSE file for copyright and license details. */
 #pragma once
 
+#include <algorithm>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 #define BETWEEN(X, A, B) ((A) <= (X) && (X) <= (B))
 
@@ -10,6 +12,37 @@ struct Rect {
     int x = 0, y = 0, width = 0, height = 0;
 
     int getIntersection(const Rect& other) const;
+    bool contains(int px, int py) const;
+    bool touches(const Rect& other) const;
+    Rect getBoundingBox(const Rect& other) const;
+
+    bool operator==(const Rect&) const = default;
+};
+
+/* Areas that need repainting. Rectangles that overlap or touch are merged, so
+ * a burst of small exposures collapses into a few larger copies. */
+class DamageRegion {
+  public:
+    void add(Rect);
+    void clear();
+    bool empty() const;
+    const std::vector<Rect>& getRects() const;
+
+  private:
+    std::vector<Rect> fRects;
+};
+
+/* Finds which of a few rectangles contains a point. The plane is cut into a
+ * grid along every rectangle edge, so a lookup is two binary searches. */
+class RectIndex {
+  public:
+    void rebuild(const std::vector<Rect>&);
+    /* Index of the first rectangle containing the point, -1 if none does */
+    int find(int x, int y) const;
+
+  private:
+    std::vector<int> fXs, fYs; /* sorted, unique edges */
+    std::vector<int> fCells;   /* row-major, one less than edges each way */
 };
 
 template <typename Container, typename LocationIt>
@@ -24,4 +57,13 @@ inline bool contains(const std::string_view haystack,
     return std::string_view::npos != haystack.find(needle);
 }
 
+template <typename Callback>
+inline void forEachLine(std::string_view text, const Callback& callback) {
+    while (!text.empty()) {
+        const auto end = std::min(text.find('\n'), text.size());
+        callback(text.substr(0, end));
+        text.remove_prefix(std::min(end + 1, text.size()));
+    }
+}
+
 void die(const char* fmt, ...);